@@ -8,9 +8,11 @@
 #include <analysis/analysis.h>
 #include <fitter.h>
 #include <fit_functions.h>
+#include <fit_scan.h>
 #include <global.h>
 #include <my_dirac.h>
 #include <convert.h>
+#include <running.h>
 
 #endif
 
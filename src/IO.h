@@ -62,6 +62,15 @@ T parseParam(Grid::XmlReader &reader,const std::string &label)
     return data;
 }
 
+// as parseParam but returns fallback if the label is not in the xml
+template <typename T>
+T parseParam(Grid::XmlReader &reader,const std::string &label,const T &fallback) 
+{
+    if(!reader.push(label)){ return fallback; }
+    reader.pop();
+    return parseParam<T>(reader,label);
+}
+
 
 // recursive mkdir /////////////////////////////////////////////////////////////
 //  coppied from Hadrons  - Antonin portelli's code. Should probably just import hadrons too
@@ -117,9 +126,10 @@ void save_result(std::string output_file, std::string label, T result)
 template <typename T>
 void save_result(std::string output_file, std::vector<std::string> labels, std::vector<T> results)
 {
-    if(labels.size != results.size)
+    if(labels.size() != results.size())
     {
         std::cout << "Error - there must be the same number of labels and results" << std::endl;
+        exit(1);
     }
     // Find the name of the path and create if doens't exist
     size_t index = output_file.find_last_of("/");
@@ -137,7 +147,7 @@ void save_result(std::string output_file, std::vector<std::string> labels, std::
 template <typename T>
 void save_result(std::string output_file, std::vector<std::vector<std::string>> labels, std::vector<std::vector<T>> results)
 {
-    if(labels.size != results.size)
+    if(labels.size() != results.size())
     {
         std::cout << "Error - there must be the same number of labels and results" << std::endl;
         exit(1);
@@ -151,7 +161,7 @@ void save_result(std::string output_file, std::vector<std::vector<std::string>>
     Grid::Hdf5Writer writer(output_file);
     for(int i=0;i<labels.size();i++)
     {
-        if(labels[i].size != results[i].size())
+        if(labels[i].size() != results[i].size())
         {
             std::cout << "Error - there must be the same number of labels and results" << std::endl;
             exit(1);
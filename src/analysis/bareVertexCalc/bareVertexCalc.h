@@ -4,5 +4,6 @@
 #include "amputation.h"
 #include "bilinear_projection.h"
 #include "fourquark.h"
+#include "tree_cache.h"
 
 #endif
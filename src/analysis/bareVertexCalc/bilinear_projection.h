@@ -8,8 +8,12 @@
 #include <Grid/Eigen/Dense>
 #include <Grid/Eigen/SVD>
 #include <complex>
+#include <random>
+#include <algorithm>
 #include "distribution/distribution.h"
 #include "maths/maths.h"
+#include "sparse_gamma.h"
+#include "amputation.h"
 
 //////////////////////////////////////////////////////////////////////////
 // Project amputated vertex functions in the gamma scheme
@@ -17,45 +21,29 @@
 // P  - 1/12 Tr ( LambdaP * g5 )
 // V  - 1/48 Tr ( LambdaV^mu * gmu )
 // A  - 1/48 Tr ( LambdaA^mu * gmu * g5 )
+// The traces with a gamma are read off the vertex directly ( sparse_gamma_trace ),
+// 12 phased elements instead of the full spin colour product.
 /////////////////////////////////////////////////////////////////////////
 template <typename T>
-Distribution<Grid::Real> project_gamma(std::vector<Distribution<T>> amp_vertex, std::vector<Grid::QCD::Gamma::Algebra> gamma_indices)
+Distribution<Grid::Real> project_gamma(std::vector<Distribution<T>> &amp_vertex, std::vector<Grid::QCD::Gamma::Algebra> gamma_indices)
 {
-    
-    Distribution<Grid::QCD::ComplexD> tr;
-    for (int mu=0;mu<gamma_indices.size();mu++)
+    int nSamples = amp_vertex[gamma_indices[0]].size();
+    std::vector<Grid::Real> tr(nSamples);
+    for(int i=0;i<nSamples;i++)
     {
-        auto gi = gamma_indices[mu];
-        if( mu == 0)
-        {
-            tr = trace( amp_vertex[gi] * Grid::QCD::Gamma(gi) ); 
-        }
-        else
-        {
-            tr = tr +  trace( amp_vertex[gi] * Grid::QCD::Gamma(gi) );
-        }
+        Grid::QCD::ComplexD tr_i = 0;
+        for(auto gi : gamma_indices){ tr_i += sparse_gamma_trace(amp_vertex[gi].get_value(i),SparseGamma(gi)); }
+        tr[i] = real(tr_i)/(12.0*gamma_indices.size());
     }
-    return real(tr*(1/(12.0*gamma_indices.size())));
+    return Distribution<Grid::Real>(tr);
 }
 
 template <typename T>
-Grid::RealD project_gamma(std::vector<T> amp_vertex, std::vector<Grid::QCD::Gamma::Algebra> gamma_indices)
+Grid::RealD project_gamma(std::vector<T> &amp_vertex, std::vector<Grid::QCD::Gamma::Algebra> gamma_indices)
 {
-    
-    Grid::QCD::ComplexD tr;
-    for (int mu=0;mu<gamma_indices.size();mu++)
-    {
-        auto gi = gamma_indices[mu];
-        if( mu == 0)
-        {
-            tr = trace( amp_vertex[gi] * Grid::QCD::Gamma(gi) ); 
-        }
-        else
-        {
-            tr = tr +  trace( amp_vertex[gi] * Grid::QCD::Gamma(gi) );
-        }
-    }
-    return real(tr*(1/(12.0*gamma_indices.size())));
+    Grid::QCD::ComplexD tr = 0;
+    for(auto gi : gamma_indices){ tr += sparse_gamma_trace(amp_vertex[gi],SparseGamma(gi)); }
+    return real(tr)/(12.0*gamma_indices.size());
 }
 
 
@@ -65,11 +53,81 @@ Grid::RealD project_gamma(std::vector<T> amp_vertex, std::vector<Grid::QCD::Gamm
 // P  - 1/12 Tr ( Lambda P * g5 )
 // V  - 1/12q^2 Tr ( qmu * LambdaV^mu  * qslash ) = 1/12q^2 Tr ( q_mu * LambdaV_mu * gamma_nu * q_nu )
 // A  - 1/12q^2 Tr ( qmu * LambdaA^mu * g5 * qslash ) = 1/12q^2 Tr ( q_mu * LambdaV_mu * gamma5 & gamma_nu * q_nu )
+// q and qsq cancel for S and P, which just use the gamma scheme.
 /////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////
+// qslash projectors for a batch of momenta, precomputed once per kinematic point.
+// Row k holds q_mu qslash_k(t,s) / 12q^2 at column (mu,s,t), qslash_k = sum_nu q_nu Gamma_nu,
+// so against the colour traced vertices tr_c Lambda_mu(s,t) of one sample
+// the projection is a single dot product, and a batch of samples one matrix product.
+////////////////////////////////////////////////////
+Eigen::MatrixXcd qslash_projectors(const std::vector<std::vector<double>> &q, const std::vector<Grid::QCD::Gamma::Algebra> &gamma_indices)
+{
+    int n = gamma_indices.size();
+    Eigen::MatrixXcd projectors = Eigen::MatrixXcd::Zero(q.size(),16*n);
+    for(int k=0;k<q.size();k++)
+    {
+        double qsq = 0;
+        for(int mu=0;mu<n;mu++){ qsq += q[k][mu]*q[k][mu]; }
+
+        Grid::QCD::SpinMatrix qslash = Grid::QCD::zero;
+        for(int nu=0;nu<n;nu++){ qslash = qslash + q[k][nu]*SparseGamma(gamma_indices[nu]).dense(); }
+
+        for(int mu=0;mu<n;mu++)
+        for(int s=0;s<4;s++)
+        for(int t=0;t<4;t++)
+        {
+            projectors(k,16*mu+4*s+t) = q[k][mu]*qslash()(t,s)()/(12.0*qsq);
+        }
+    }
+    return projectors;
+}
+
+// several momenta ( each with Gamma: X Y Z T ordering as q ) in one pass over the samples
+template <typename T>
+std::vector<Distribution<Grid::Real>> project_qslash(std::vector<Distribution<T>> &amp_vertex, std::vector<std::vector<double>> q, std::vector<Grid::QCD::Gamma::Algebra> gamma_indices)
+{
+    int n        = gamma_indices.size();
+    int nSamples = amp_vertex[gamma_indices[0]].size();
+    Eigen::MatrixXcd projectors = qslash_projectors(q,gamma_indices);
+
+    // colour traced vertices, one column per sample
+    Eigen::MatrixXcd traced(16*n,nSamples);
+    parallel_for(int i=0;i<nSamples;i++)
+    {
+        for(int mu=0;mu<n;mu++)
+        {
+            T amp = amp_vertex[gamma_indices[mu]].get_value(i);
+            for(int s=0;s<4;s++)
+            for(int t=0;t<4;t++)
+            {
+                Grid::ComplexD tc = 0;
+                for(int c=0;c<Grid::QCD::Nc;c++){ tc += amp()(s,t)(c,c); }
+                traced(16*mu+4*s+t,i) = tc;
+            }
+        }
+    }
+
+    Eigen::MatrixXd projected = (projectors*traced).real();
+    std::vector<Distribution<Grid::Real>> lambdas;
+    for(int k=0;k<q.size();k++)
+    {
+        std::vector<Grid::Real> values(nSamples);
+        for(int i=0;i<nSamples;i++){ values[i] = projected(k,i); }
+        lambdas.push_back(Distribution<Grid::Real>(values,amp_vertex[gamma_indices[0]].get_resamplingType()));
+    }
+    return lambdas;
+}
+
+template <typename T>
+Distribution<Grid::Real> project_qslash(std::vector<Distribution<T>> &amp_vertex, std::vector<double> q, std::vector<Grid::QCD::Gamma::Algebra> gamma_indices)
+{
+    return project_qslash(amp_vertex,std::vector<std::vector<double>>(1,q),gamma_indices).front();
+}
+
 template <typename T>
-Distribution<Grid::Real> project_qslash(std::vector<Distribution<T>> amp_vertex, std::vector<double> q, std::vector<Grid::QCD::Gamma::Algebra> gamma_indices)
+Grid::Real project_qslash(std::vector<T> &amp_vertex, std::vector<double> q, std::vector<Grid::QCD::Gamma::Algebra> gamma_indices)
 {
-   
     //// qsq ///////////////////////////////////
     double qsq = 0;
     for(int mu=0;mu<gamma_indices.size();mu++)
@@ -77,71 +135,216 @@ Distribution<Grid::Real> project_qslash(std::vector<Distribution<T>> amp_vertex,
         qsq += q[mu]*q[mu];
     }
 
+    // q[mu] * Lambda_mu * Gamma_mu * q[mu], diagonal in mu
+    Grid::QCD::ComplexD tr = 0;
+    for(int mu=0;mu<gamma_indices.size();mu++)
+    {
+        tr += q[mu]*q[mu]*sparse_gamma_trace(amp_vertex[gamma_indices[mu]],SparseGamma(gamma_indices[mu]));
+    }
+    return real(tr)/(12.0*qsq);
+}
 
-    //// Trace ///////////////////////////////////
-    // needed only for V and A
-    // q[mu] and qsq s cancel for P and S, but can just use the gamma scheme
-    Distribution<Grid::QCD::ComplexD> tr;
-    Distribution<Grid::QCD::ComplexD> tr_mu;
+//////////////////////////////////////////////////////////////////////////
+// Fused projection of all bilinear channels
+// A channel is a list of gammas projected in the gamma or qslash scheme as above, times a
+// sign, or the difference of two earlier channels ( e.g. S - P ). The samples are walked in
+// parallel and each takes all of its traces in one pass, so the only distributions formed
+// are the final Lambdas. A sample provides
+//      projector(gammas,w)     - the projector sum_k w_k Gamma_k
+//      trace(g,projector)      - tr( Lambda_g * projector )
+// either from amputated vertices or, projection first, from the raw vertex and props.
+/////////////////////////////////////////////////////////////////////////
+struct BilinearChannel
+{
+    std::string                             name;
+    std::vector<Grid::QCD::Gamma::Algebra>  gammas;
+    double                                  sign;
+    bool                                    qslash;
+    int                                     plus;
+    int                                     minus;
 
-    for(int mu=0;mu<gamma_indices.size();mu++)
+    BilinearChannel(std::string name, std::vector<Grid::QCD::Gamma::Algebra> gammas, double sign=1, bool qslash=false)
+        : name(name), gammas(gammas), sign(sign), qslash(qslash), plus(-1), minus(-1) {}
+    BilinearChannel(std::string name, int plus, int minus)
+        : name(name), sign(1), qslash(false), plus(plus), minus(minus) {}
+};
+
+// tr( a * b ) over spin and colour without forming the product
+Grid::ComplexD trace_product(const Grid::QCD::SpinColourMatrix &a, const Grid::QCD::SpinColourMatrix &b)
+{
+    Grid::ComplexD tr = 0;
+    for(int s1=0;s1<Grid::QCD::Ns;s1++)
+    for(int s2=0;s2<Grid::QCD::Ns;s2++)
+    for(int c1=0;c1<Grid::QCD::Nc;c1++)
+    for(int c2=0;c2<Grid::QCD::Nc;c2++)
     {
-        //convention for gamma indexing and dimension indexing differ
-        // Gamma: T X Y Z   vs   X Y Z T
-        // 0 1 2 3    ->    3 0 1 2  ( txyz )
-        int mu_dim = mu; //(mu+3)%4; 
-        auto gmu = gamma_indices[mu];
-            
-        for (int nu=0;nu<gamma_indices.size();nu++)
-        {
+        tr += a()(s1,s2)(c1,c2)*b()(s2,s1)(c2,c1);
+    }
+    return tr;
+}
+
+// sample i of the amputated vertices, traces read off with the sparse gammas
+class AmputatedSample
+{
+    private:
+        std::vector<Distribution<Grid::QCD::SpinColourMatrix>> &amp_vertex;
+        int i;
+
+    public:
+        typedef std::pair<std::vector<Grid::QCD::Gamma::Algebra>,std::vector<double>> Projector;
+
+        AmputatedSample(std::vector<Distribution<Grid::QCD::SpinColourMatrix>> &amp_vertex, int i) : amp_vertex(amp_vertex), i(i) {}
 
-            //indexing for qslash 
-            auto gnu = gamma_indices[nu];
-            int  nu_dim = nu;//(nu+3)%4; // 0 -> 3, 1->0, etc
-            
+        Projector       projector(const std::vector<Grid::QCD::Gamma::Algebra> &gammas, const std::vector<double> &w){ return Projector(gammas,w); }
+        Grid::ComplexD  trace(Grid::QCD::Gamma::Algebra g, const Projector &p){ return sparse_gamma_trace(amp_vertex[g].get_value(i),p.first,p.second); }
+};
 
-            // Final result is :  trace( q[mu]*PI[mu] * sum (Gamma[nu]*q[nu]) ) = trace( q[mu]*PI[mu]*qslash )
-            // here we 
-            auto proj_nu = q[mu_dim] * amp_vertex[gmu] * Grid::QCD::Gamma(gnu) * q[nu_dim]; 
+////////////////////////////////////////////////////
+// sample i of the raw vertices, with the amputation moved onto the projector
+//      Tr( S1^-1 V S2^-1 Gamma ) = Tr( V * S2^-1 Gamma S1^-1 )
+// so each projector is amputated once per sample and the amputated vertices are never formed
+////////////////////////////////////////////////////
+class UnamputatedSample
+{
+    private:
+        std::vector<Distribution<Grid::QCD::SpinColourMatrix>> &vertex;
+        int i;
+        Grid::QCD::SpinColourMatrix propInv1, propInv2;
+
+    public:
+        typedef Grid::QCD::SpinColourMatrix Projector;
+
+        UnamputatedSample(Distribution<Grid::QCD::SpinColourMatrix> &prop1, Distribution<Grid::QCD::SpinColourMatrix> &prop2, std::vector<Distribution<Grid::QCD::SpinColourMatrix>> &vertex, int i)
+            : vertex(vertex), i(i), propInv1(invert(prop1.get_value(i))), propInv2(invert(prop2.get_value(i))) {}
 
-            // take trace over nu for mu component 
-            (nu == 0) ? tr_mu = trace( proj_nu ) : tr_mu = tr_mu + trace(proj_nu);
+        // S2^-1 ( sum_k w_k Gamma_k ) S1^-1
+        Projector projector(const std::vector<Grid::QCD::Gamma::Algebra> &gammas, const std::vector<double> &w)
+        {
+            Grid::QCD::SpinColourMatrix gw = Grid::QCD::zero;
+            for(int k=0;k<gammas.size();k++){ gw = gw + w[k]*(propInv2*SparseGamma(gammas[k])); }
+            return gw*propInv1;
         }
+        Grid::ComplexD trace(Grid::QCD::Gamma::Algebra g, const Projector &p){ return trace_product(vertex[g].get_value(i),p); }
+};
 
-        // trace over mu 
-        (mu == 0 ) ? tr = tr_mu : tr = tr +tr_mu;
+template<class F>
+std::vector<Distribution<Grid::Real>> project_bilinear_channels(int nSamples, std::string resampling, std::vector<double> q, const std::vector<BilinearChannel> &channels, F sample)
+{
+    double qsq = 0;
+    for(auto qmu : q){ qsq += qmu*qmu; }
+
+    for(int k=0;k<channels.size();k++)
+    {
+        if(channels[k].plus >= k || channels[k].minus >= k)
+        {
+            std::cout << "Error: bilinear channel " << channels[k].name << " is the difference of later channels" << std::endl;
+            return std::vector<Distribution<Grid::Real>>();
+        }
+    }
+
+    std::vector<std::vector<Grid::Real>> values(channels.size(),std::vector<Grid::Real>(nSamples));
+
+    parallel_for(int i=0;i<nSamples;i++)
+    {
+        auto s = sample(i);
+        for(int k=0;k<channels.size();k++)
+        {
+            const BilinearChannel &ch = channels[k];
+            if(ch.plus >= 0)
+            {
+                values[k][i] = values[ch.plus][i] - values[ch.minus][i];
+                continue;
+            }
+
+            int n = ch.gammas.size();
+            Grid::ComplexD tr = 0;
+            if(ch.qslash)
+            {
+                // q_mu * Lambda_mu * qslash, one qslash projector for all mu
+                auto qslash = s.projector(ch.gammas,std::vector<double>(q.begin(),q.begin()+n));
+                for(int mu=0;mu<n;mu++){ tr += q[mu]*s.trace(ch.gammas[mu],qslash); }
+            }
+            else
+            {
+                for(int mu=0;mu<n;mu++){ tr += s.trace(ch.gammas[mu],s.projector({ch.gammas[mu]},{1.0})); }
+            }
+            values[k][i] = ch.sign*real(tr)/(ch.qslash ? 12.0*qsq : 12.0*n);
+        }
     }
-    return real(tr*(1/(12.0*qsq)));
+
+    std::vector<Distribution<Grid::Real>> lambdas;
+    for(auto v : values){ lambdas.push_back(Distribution<Grid::Real>(v,resampling)); }
+    return lambdas;
 }
 
-template <typename T>
-Grid::Real project_qslash(std::vector<T> amp_vertex, std::vector<double> q, std::vector<Grid::QCD::Gamma::Algebra> gamma_indices)
+// from amputated vertices
+std::vector<Distribution<Grid::Real>> project_bilinears(std::vector<Distribution<Grid::QCD::SpinColourMatrix>> &amp_vertex, std::vector<double> q, const std::vector<BilinearChannel> &channels)
 {
-   
-    //// qsq ///////////////////////////////////
-    double qsq = 0;
-    for(int mu=0;mu<gamma_indices.size();mu++)
+    return project_bilinear_channels(amp_vertex.front().size(),amp_vertex.front().get_resamplingType(),q,channels,
+                                     [&](int i){ return AmputatedSample(amp_vertex,i); });
+}
+
+// projection first, from the raw vertices and the props ( amputated as S1^-1 V S2^-1 )
+std::vector<Distribution<Grid::Real>> project_bilinears(Distribution<Grid::QCD::SpinColourMatrix> &prop1, Distribution<Grid::QCD::SpinColourMatrix> &prop2, std::vector<Distribution<Grid::QCD::SpinColourMatrix>> &vertex, std::vector<double> q, const std::vector<BilinearChannel> &channels)
+{
+    return project_bilinear_channels(vertex.front().size(),vertex.front().get_resamplingType(),q,channels,
+                                     [&](int i){ return UnamputatedSample(prop1,prop2,vertex,i); });
+}
+
+////////////////////////////////////////////////////
+// The batched qslash projection of several momenta on random vertices against
+// sum_mu,nu q_mu q_nu tr( Lambda_mu Gamma_nu ) / 12q^2 from the sparse traces, momentum by momentum
+////////////////////////////////////////////////////
+bool qslash_projection_check(const std::vector<Grid::QCD::Gamma::Algebra> &gamma_indices, int nSamples=3)
+{
+    std::mt19937                            gen(4321);
+    std::uniform_real_distribution<double>  uniform(-1,1);
+
+    std::vector<Distribution<Grid::QCD::SpinColourMatrix>> amp_vertex(Grid::QCD::Gamma::nGamma);
+    for(auto g : gamma_indices)
     {
-        qsq += q[mu]*q[mu];
+        std::vector<Grid::QCD::SpinColourMatrix> values(nSamples);
+        for(auto &m : values)
+        for(int s=0;s<Grid::QCD::Ns;s++)
+        for(int t=0;t<Grid::QCD::Ns;t++)
+        for(int a=0;a<Grid::QCD::Nc;a++)
+        for(int b=0;b<Grid::QCD::Nc;b++)
+        {
+            m()(s,t)(a,b) = Grid::ComplexD(uniform(gen),uniform(gen));
+        }
+        amp_vertex[g] = Distribution<Grid::QCD::SpinColourMatrix>(values);
     }
 
-    //// Trace ///////////////////////////////////
-    // needed only for V and A
-    // q[mu] and qsq s cancel for P and S, but can just use the gamma scheme
-    Grid::QCD::ComplexD tr;
-    for(int mu=0;mu<gamma_indices.size();mu++)
+    std::vector<std::vector<double>> q(3,std::vector<double>(gamma_indices.size()));
+    for(auto &qk : q)
+    for(auto &qmu : qk)
     {
-        auto gi = gamma_indices[mu];
-        if(mu==0)
-        {
-            tr = trace( q[mu] * amp_vertex[gi] * Grid::QCD::Gamma(gi) * q[mu] );
-        } 
-        else 
+        qmu = uniform(gen);
+    }
+    std::vector<Distribution<Grid::Real>> batch = project_qslash(amp_vertex,q,gamma_indices);
+
+    double diff = 0;
+    for(int k=0;k<q.size();k++)
+    {
+        double qsq = 0;
+        for(auto qmu : q[k]){ qsq += qmu*qmu; }
+        for(int i=0;i<nSamples;i++)
         {
-            tr = tr +  trace( q[mu] * amp_vertex[gi] * Grid::QCD::Gamma(gi) * q[mu] );
+            Grid::ComplexD tr = 0;
+            for(int mu=0;mu<gamma_indices.size();mu++)
+            for(int nu=0;nu<gamma_indices.size();nu++)
+            {
+                tr += q[k][mu]*q[k][nu]*sparse_gamma_trace(amp_vertex[gamma_indices[mu]].get_value(i),SparseGamma(gamma_indices[nu]));
+            }
+            diff = std::max(diff,std::abs(batch[k].get_value(i) - real(tr)/(12.0*qsq)));
         }
     }
-    return real(tr*(1/(12.0*qsq)));
+    if(diff > 1e-12)
+    {
+        std::cout << "Error: batched qslash projection differs from the direct traces by " << diff << std::endl;
+        return false;
+    }
+    return true;
 }
 
 #endif
@@ -0,0 +1,177 @@
+#ifndef CONTRACTION_H
+#define CONTRACTION_H
+
+#include "Grid/Grid.h"
+#include <initializer_list>
+#include <type_traits>
+
+////////////////////////////////////
+//  einsum style contractions of flat row major tensors
+//
+//      Indices are labelled types and a tensor is described by the Layout of its indices,
+//      e.g. the leg reordering l[(s1,s2,c1,c2)] = L(s2,s1)(c2,c1) is
+//          Contraction< Layout<S1,S2,C1,C2>, Layout<S2,S1,C2,C1> >
+//      The first layout is the output, labels missing from it are summed over and a label
+//      repeated within one layout takes the diagonal (a trace). Everything is resolved at
+//      compile time: each loop runs over a fixed range with constant strides, ordered with
+//      the largest summed stride outermost so the innermost loop walks the memory with the
+//      smallest stride, and the recursion unrolls into a plain loop nest.
+////////////////////////////////////
+
+template<char label, int dim>
+struct Index
+{
+    static constexpr char   name = label;
+    static constexpr int    size = dim;
+};
+
+template<char label> using SpinIndexLabel   = Index<label,Grid::QCD::Ns>;
+template<char label> using ColourIndexLabel = Index<label,Grid::QCD::Nc>;
+
+template<class... I>
+struct Layout
+{
+    static constexpr int    rank = sizeof...(I);
+
+    static constexpr char   name(int k)     { const char n[] = {I::name...,0}; return n[k]; }
+    static constexpr int    size(int k)     { const int  d[] = {I::size...,1}; return d[k]; }
+    static constexpr int    stride(int k)   { int s=1; for(int j=k+1;j<rank;j++){ s*=size(j); } return s; }
+    static constexpr int    volume()        { int v=1; for(int j=0;j<rank;j++){ v*=size(j); } return v; }
+};
+
+// layouts of the Grid spin colour tensors
+template<char s1, char s2, char c1, char c2>
+using SpinColourLayout = Layout<SpinIndexLabel<s1>,SpinIndexLabel<s2>,ColourIndexLabel<c1>,ColourIndexLabel<c2>>;
+
+template<char sa, char sb, char ca, char cb, char sc, char sd, char cc, char cd>
+using SpinColourSpinColourLayout = Layout<SpinIndexLabel<sa>,SpinIndexLabel<sb>,ColourIndexLabel<ca>,ColourIndexLabel<cb>,
+                                          SpinIndexLabel<sc>,SpinIndexLabel<sd>,ColourIndexLabel<cc>,ColourIndexLabel<cd>>;
+
+///////////////////////////////////////////////
+// loop table: distinct labels, their ranges, the stride of each in every tensor
+// ( 0 if absent, summed if repeated ) and the loop order, outermost first
+///////////////////////////////////////////////
+template<int nTensor, int maxIndex>
+struct ContractionTable
+{
+    int     nIndex;
+    bool    valid;
+    char    name[maxIndex];
+    int     size[maxIndex];
+    int     stride[nTensor][maxIndex];
+    int     order[maxIndex];
+};
+
+template<class L, class T>
+constexpr int contraction_table_add(T &t, int tensor)
+{
+    for(int k=0;k<L::rank;k++)
+    {
+        int j = 0;
+        while(j < t.nIndex && t.name[j] != L::name(k)){ j++; }
+        if(j == t.nIndex)
+        {
+            t.name[j] = L::name(k);
+            t.size[j] = L::size(k);
+            t.nIndex++;
+        }
+        t.valid = t.valid && (t.size[j] == L::size(k));
+        t.stride[tensor][j] += L::stride(k);
+    }
+    return 0;
+}
+
+// total rank of the layouts + 1, bounds the number of distinct labels
+template<class... L>
+struct ContractionTableSize{ static constexpr int value = 1; };
+template<class L, class... Rest>
+struct ContractionTableSize<L,Rest...>{ static constexpr int value = L::rank + ContractionTableSize<Rest...>::value; };
+
+template<class... L>
+constexpr ContractionTable<sizeof...(L),ContractionTableSize<L...>::value> make_contraction_table()
+{
+    ContractionTable<sizeof...(L),ContractionTableSize<L...>::value> t{};
+    t.valid = true;
+    int tensor = 0;
+    int expand[] = {contraction_table_add<L>(t,tensor++)...};
+    (void)expand;
+
+    // largest total stride outermost, first appearance breaks ties
+    int total[ContractionTableSize<L...>::value] = {};
+    for(int j=0;j<t.nIndex;j++)
+    {
+        t.order[j] = j;
+        for(int n=0;n<sizeof...(L);n++){ total[j] += t.stride[n][j]; }
+    }
+    for(int a=0;a<t.nIndex;a++)
+    for(int b=t.nIndex-1;b>a;b--)
+    {
+        if(total[t.order[b]] > total[t.order[b-1]])
+        {
+            int tmp = t.order[b]; t.order[b] = t.order[b-1]; t.order[b-1] = tmp;
+        }
+    }
+    return t;
+}
+
+///////////////////////////////////////////////
+// Out = scale * sum over the summed labels of prod In
+///////////////////////////////////////////////
+template<class Out, class... In>
+struct Contraction
+{
+    static constexpr int nIn = sizeof...(In);
+    typedef ContractionTable<1+nIn,ContractionTableSize<Out,In...>::value> Table;
+    static constexpr Table table = make_contraction_table<Out,In...>();
+    static_assert(table.valid, "label used with different ranges");
+
+    // out = scale * contraction
+    static void assign(Grid::ComplexD *out, std::initializer_list<const Grid::ComplexD *> in, double scale=1.)
+    {
+        for(int k=0;k<Out::volume();k++){ out[k] = 0; }
+        accumulate(out,in,scale);
+    }
+
+    // out += scale * contraction
+    static void accumulate(Grid::ComplexD *out, std::initializer_list<const Grid::ComplexD *> in, double scale=1.)
+    {
+        const Grid::ComplexD *ptr[nIn];
+        int n = 0;
+        for(auto p : in){ ptr[n++] = p; }
+        loop(std::integral_constant<int,0>(),out,ptr,scale);
+    }
+
+    // scalar output
+    static Grid::ComplexD eval(std::initializer_list<const Grid::ComplexD *> in)
+    {
+        static_assert(Out::rank == 0, "eval needs a scalar output");
+        Grid::ComplexD out = 0;
+        accumulate(&out,in);
+        return out;
+    }
+
+    private:
+        static void loop(std::integral_constant<int,table.nIndex>, Grid::ComplexD *out, const Grid::ComplexD *const *in, double scale)
+        {
+            Grid::ComplexD prod = in[0][0];
+            for(int n=1;n<nIn;n++){ prod *= in[n][0]; }
+            *out += scale*prod;
+        }
+
+        template<int depth>
+        static void loop(std::integral_constant<int,depth>, Grid::ComplexD *out, const Grid::ComplexD *const *in, double scale)
+        {
+            constexpr int index = table.order[depth];
+            for(int i=0;i<table.size[index];i++)
+            {
+                const Grid::ComplexD *ptr[nIn];
+                for(int n=0;n<nIn;n++){ ptr[n] = in[n] + i*table.stride[n+1][index]; }
+                loop(std::integral_constant<int,depth+1>(),out + i*table.stride[0][index],ptr,scale);
+            }
+        }
+};
+
+template<class Out, class... In>
+constexpr typename Contraction<Out,In...>::Table Contraction<Out,In...>::table;
+
+#endif
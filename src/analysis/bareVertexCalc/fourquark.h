@@ -9,6 +9,10 @@
 #include <Grid/Eigen/SVD>
 #include <complex>
 #include "amputation.h"
+#include "fourquark_kernels.h"
+#include "fourquark_simd.h"
+#include "fourquark_mixed.h"
+#include "sparse_gamma.h"
 #include "distribution/distribution.h"
 
 
@@ -16,12 +20,54 @@ using namespace Grid;
 using namespace QCD;
 
 
+////////////////////////////////////
+//  gammas holds the dense spin matrices, sparse the same gammas as phased permutations
+//  when each is a single basis element ( empty for qslash weighted combinations )
+////////////////////////////////////
 struct DiracStructure{
     std::vector<Gamma::Algebra> indices;
     std::vector<SpinMatrix>     gammas;
+    std::vector<SparseGamma>    sparse;
     std::vector<int>            signs;
+
+    void push_back(Gamma::Algebra g)
+    {
+        indices.push_back(g);
+        sparse.push_back(SparseGamma(g));
+        gammas.push_back(sparse.back().dense());
+    }
+    bool is_sparse() const { return !gammas.empty() && sparse.size() == gammas.size(); }
+};
+
+////////////////////////////////////
+//  Mixing pattern of an operator basis. mask[i][j] is false where operator i and
+//  projector j cannot mix, e.g. by chiral symmetry, and the contraction is skipped.
+//  An empty mask is dense. With check set the skipped entries are still computed and
+//  compared to the largest entry - chiral symmetry on the lattice is only approximate,
+//  so they are reported if above tolerance relative to it rather than required to be 0.
+////////////////////////////////////
+struct MixingPattern{
+    std::vector<std::vector<bool>>  mask;
+    bool                            check       = false;
+    double                          tolerance   = 1e-3;
+
+    bool nonzero(int i, int j) const { return mask.empty() || mask[i][j]; }
 };
 
+// operators mix only within each block of indices
+MixingPattern block_mixing_pattern(std::vector<std::vector<int>> blocks, int nOp)
+{
+    MixingPattern pattern;
+    pattern.mask.assign(nOp,std::vector<bool>(nOp,false));
+    for(auto block : blocks)
+    for(int i : block)
+    for(int j : block)
+    {
+        pattern.mask[i][j] = true;
+    }
+    return pattern;
+}
+
 ////////////////////////////////////
 //  Four Quark Projections and Amputation
 //  parts:
@@ -92,78 +138,211 @@ Real projectTree(DiracStructure vertex_structure, DiracStructure projector)
     return real(tr);
 }
 */
-Real projectFourQuark(Grid::QCD::SpinColourMatrix prop1, Grid::QCD::SpinColourMatrix prop2, std::vector<Grid::QCD::SpinColourSpinColourMatrix> vertices, DiracStructure vertex_structure,DiracStructure projector, bool colourMix)
+////////////////////////////////////
+//  Matrix form of the contractions
+//
+//      Combine the spin-colour indices of the vertex into pairs, e.g. for the figure of eight
+//          r = (sa,sb,ca,cb)   c = (sc,sd,cc,cd)
+//      so the vertex is a 144x144 matrix V_rc and the leg a 144-vector l_r = L(sb,sa)(cb,ca).
+//      figure8 = l^T V l. The circle (and the colour mixed contractions) pair the indices
+//      differently, which is a permutation of V: the row takes the spin (colour) index of d
+//      instead of b and the column that of b instead of d.
+//
+//      Since both legs are the same vector, figure8-circle = l^T ( V_f8 - V_circ ) l, so one
+//      sweep over the vertex fills the difference matrix and every projector leg is then
+//      contracted at once as a column of a 144 x nLegs matrix.
+////////////////////////////////////
+typedef FourQuarkKernel<false,Grid::QCD::Ns,Grid::QCD::Nc> FourQuarkUnmixed;
+static_assert(sizeof(Grid::QCD::SpinColourSpinColourMatrix) == FourQuarkUnmixed::size*FourQuarkUnmixed::size*sizeof(ComplexD), "vertex must be stored as flat complex array");
+
+// leg as 144-vector in the paired index order
+Eigen::VectorXcd fourquark_leg(const Grid::QCD::SpinColourMatrix &leg)
 {
-    ComplexD    figure8 = 0;
-    ComplexD    circle  = 0;
-    ComplexD    tr      = 0; 
-    
-    //invert propagators
-    auto propInv1 = invert(prop1);
-    auto propInv2 = invert(prop2);
+    Eigen::VectorXcd vec(FourQuarkUnmixed::size);
+    FourQuarkUnmixed::leg(&leg()(0,0)(0,0),vec.data());
+    return vec;
+}
 
-    // let's just do SS for now. Will then change to VV and AA. 
-    // adjoint and g5 already saved in the props on disc.
-    
-    //vertex indices
-    for(int nu=0;nu<vertex_structure.signs.size();nu++)
+// V_f8 - V_circ in the paired index order
+FourQuarkMatrix fourquark_vertex_matrix(const Grid::QCD::SpinColourSpinColourMatrix &vertex, bool colourMix)
+{
+    FourQuarkMatrix matrix = FourQuarkMatrix::Zero(FourQuarkUnmixed::size,FourQuarkUnmixed::size);
+    fourquark_dispatch(colourMix,[&](auto mix){
+        FourQuarkKernel<decltype(mix)::value,Grid::QCD::Ns,Grid::QCD::Nc>::vertex_matrix(&vertex()(0,0)(0,0)(0,0)(0,0),matrix.data());
+    });
+    return matrix;
+}
+
+////////////////////////////////////
+//  Four quark vertex of one sample, summed over the gamma components of each operator
+//  in the vertex basis ( sum_nu signs[nu] * V[indices[nu]] ). The contraction is linear
+//  in the vertex so each projector leg then needs one contraction per operator instead of
+//  one per component. The summed vertex matrices are built on first use and kept, so the
+//  gamma and qslash projector sets can both be applied to the same sample.
+//  In single precision mode the matrices are kept as floats and contracted in double
+//  ( fourquark_mixed.h ).
+////////////////////////////////////
+class FourQuarkVertex
+{
+    private:
+        std::vector<Grid::QCD::SpinColourSpinColourMatrix>  combined;
+        std::vector<FourQuarkMatrix>                        matrices[2]; // unmixed, mixed
+        std::vector<FourQuarkMatrixF>                       matricesF[2];
+        std::vector<bool>                                   built[2];
+        bool                                                single_precision;
+
+    public:
+        FourQuarkVertex(const std::vector<Grid::QCD::SpinColourSpinColourMatrix> &vertices, const std::vector<DiracStructure> &vertex_structure, bool single=fourquark_mixed_precision());
+        size_t                      size(){ return combined.size(); }
+        bool                        single(){ return single_precision; }
+        const FourQuarkMatrix &     get_matrix(int i, bool colourMix);
+        const FourQuarkMatrixF &    get_matrix_single(int i, bool colourMix);
+};
+
+FourQuarkVertex::FourQuarkVertex(const std::vector<Grid::QCD::SpinColourSpinColourMatrix> &vertices, const std::vector<DiracStructure> &vertex_structure, bool single) : single_precision(single)
+{
+    combined.resize(vertex_structure.size());
+    for(int i=0;i<vertex_structure.size();i++)
     {
-        auto vertex = vertices[vertex_structure.indices[nu]];
-        //projector indices
-        for(int mu=0;mu<projector.signs.size();mu++)
-        {
+        std::vector<const ComplexD *> components;
+        for(auto g : vertex_structure[i].indices){ components.push_back(&vertices[g]()(0,0)(0,0)(0,0)(0,0)); }
+        fourquark_signed_sum(components,vertex_structure[i].signs,&combined[i]()(0,0)(0,0)(0,0)(0,0),FourQuarkUnmixed::size*FourQuarkUnmixed::size);
+    }
+    for(int mix=0;mix<2;mix++)
+    {
+        if(single_precision){ matricesF[mix].resize(combined.size()); }
+        else                { matrices[mix].resize(combined.size()); }
+        built[mix].assign(combined.size(),false);
+    }
+}
 
-            auto sc_mat_1 = propInv1*projector.gammas[mu]*propInv2;
-            auto sc_mat_2 = sc_mat_1;
+const FourQuarkMatrix & FourQuarkVertex::get_matrix(int i, bool colourMix)
+{
+    if(!built[colourMix][i])
+    {
+        matrices[colourMix][i]  = fourquark_vertex_matrix(combined[i],colourMix);
+        built[colourMix][i]     = true;
+    }
+    return matrices[colourMix][i];
+}
 
-            int ns(Grid::QCD::Ns);
-            int nc(Grid::QCD::Nc);
+// only the single precision copy is kept
+const FourQuarkMatrixF & FourQuarkVertex::get_matrix_single(int i, bool colourMix)
+{
+    if(!built[colourMix][i])
+    {
+        matricesF[colourMix][i] = fourquark_vertex_matrix(combined[i],colourMix).cast<Grid::ComplexF>();
+        built[colourMix][i]     = true;
+    }
+    return matricesF[colourMix][i];
+}
 
-            figure8 = 0;
-            circle  = 0;
+// projection of a summed vertex - propagators already inverted
+Eigen::MatrixXd projectFourQuark(FourQuarkVertex &vertex, const Grid::QCD::SpinColourMatrix &propInv1, const Grid::QCD::SpinColourMatrix &propInv2, std::vector<DiracStructure> projector, std::vector<bool> colourMix, const MixingPattern &pattern = MixingPattern())
+{
+    // adjoint and g5 already saved in the props on disc.
 
-            // trace over spin and colour
-            for(int cc=0;cc<nc;cc++)
-            for(int cd=0;cd<nc;cd++)
-            for(int sc=0;sc<ns;sc++)
-            for(int sd=0;sd<ns;sd++)
+    // legs for all projectors, grouped by colour mixing so each group runs through one
+    // kernel instantiation. offset[j] is the first column of projector j in its group
+    typedef Eigen::Matrix<ComplexD,FourQuarkUnmixed::size,Eigen::Dynamic> LegMatrix;
+    int nLegs[2] = {0,0};
+    std::vector<int> offset(projector.size());
+    for(int j=0;j<projector.size();j++)
+    {
+        offset[j] = nLegs[colourMix[j]];
+        nLegs[colourMix[j]] += projector[j].signs.size();
+    }
+    LegMatrix legs[2] = {LegMatrix(FourQuarkUnmixed::size,nLegs[0]),LegMatrix(FourQuarkUnmixed::size,nLegs[1])};
+    for(int j=0;j<projector.size();j++)
+    for(int mu=0;mu<projector[j].signs.size();mu++)
+    {
+        SpinColourMatrix leg = projector[j].is_sparse() ? (propInv1*projector[j].sparse[mu])*propInv2 : propInv1*projector[j].gammas[mu]*propInv2;
+        FourQuarkUnmixed::leg(&leg()(0,0)(0,0),legs[colourMix[j]].col(offset[j]+mu).data());
+    }
+
+    // one contraction per operator against the legs of the projectors it mixes with
+    auto contract = [&](int i, bool mix, const LegMatrix &l) -> Eigen::VectorXcd
+    {
+        if(vertex.single()){ return fourquark_contract_mixed<FourQuarkUnmixed::size>(vertex.get_matrix_single(i,mix),l); }
+        return fourquark_contract<FourQuarkUnmixed::size>(vertex.get_matrix(i,mix),l);
+    };
+
+    Eigen::MatrixXd trace = Eigen::MatrixXd::Zero(vertex.size(),projector.size());
+    for(int i=0;i<vertex.size();i++)
+    {
+        // column[j] is the first column of projector j among the legs used, -1 if skipped
+        int nUsed[2] = {0,0};
+        std::vector<int> column(projector.size(),-1);
+        for(int j=0;j<projector.size();j++)
+        {
+            if(!pattern.check && !pattern.nonzero(i,j)){ continue; }
+            column[j] = nUsed[colourMix[j]];
+            nUsed[colourMix[j]] += projector[j].signs.size();
+        }
+
+        Eigen::VectorXcd contracted[2];
+        for(int mix=0;mix<2;mix++)
+        {
+            if(nUsed[mix] == 0){ continue; }
+            if(nUsed[mix] == nLegs[mix])
             {
-            for(int ca=0;ca<nc;ca++)
-            for(int cb=0;cb<nc;cb++)
-            for(int sa=0;sa<ns;sa++)
-            for(int sb=0;sb<ns;sb++)
+                contracted[mix] = contract(i,mix,legs[mix]);
+                continue;
+            }
+            LegMatrix used(FourQuarkUnmixed::size,nUsed[mix]);
+            for(int j=0;j<projector.size();j++)
             {
-                if(colourMix)
-                {
-                    figure8   += sc_mat_1()(sb,sa)(cd,ca)*vertex()(sa,sb)(ca,cb)(sc,sd)(cc,cd)*sc_mat_2()(sd,sc)(cb,cc);
-                    circle    += sc_mat_1()(sd,sa)(cb,ca)*vertex()(sa,sb)(ca,cb)(sc,sd)(cc,cd)*sc_mat_2()(sb,sc)(cd,cc);
-                }
-                else
-                {
-                    figure8   += sc_mat_1()(sb,sa)(cb,ca)*vertex()(sa,sb)(ca,cb)(sc,sd)(cc,cd)*sc_mat_2()(sd,sc)(cd,cc);
-                    circle    += sc_mat_1()(sd,sa)(cd,ca)*vertex()(sa,sb)(ca,cb)(sc,sd)(cc,cd)*sc_mat_2()(sb,sc)(cb,cc);
-                }
+                if(column[j] >= 0 && colourMix[j] == mix){ used.middleCols(column[j],projector[j].signs.size()) = legs[mix].middleCols(offset[j],projector[j].signs.size()); }
             }
+            contracted[mix] = contract(i,mix,used);
+        }
+        for(int j=0;j<projector.size();j++)
+        {
+            if(column[j] < 0){ continue; }
+            ComplexD tr = 0;
+            for(int mu=0;mu<projector[j].signs.size();mu++)
+            {
+                tr += projector[j].signs[mu]*2*contracted[colourMix[j]](column[j]+mu);
             }
-            tr += vertex_structure.signs[nu]*projector.signs[mu]*2*(figure8-circle);
-            //std::cout << nu << " " << mu << " " << 2*(figure8-circle) << std::endl; 
+            trace(i,j) = real(tr);
         }
     }
-    return real(tr);
-}
 
-Eigen::MatrixXd projectFourQuark(Grid::QCD::SpinColourMatrix prop1, Grid::QCD::SpinColourMatrix prop2, std::vector<Grid::QCD::SpinColourSpinColourMatrix> vertices, std::vector<DiracStructure> vertex_structure,std::vector<DiracStructure> projector, std::vector<bool> colourMix)
-{
-    Eigen::MatrixXd trace(vertex_structure.size(),projector.size());
-    for(int i=0;i<vertex_structure.size();i++)
-    for(int j=0;j<projector.size();j++)
+    if(pattern.check && !pattern.mask.empty())
     {
-        trace(i,j) = projectFourQuark(prop1,prop2,vertices,vertex_structure[i],projector[j],colourMix[j]);
+        double largest = trace.cwiseAbs().maxCoeff();
+        for(int i=0;i<trace.rows();i++)
+        for(int j=0;j<trace.cols();j++)
+        {
+            if(!pattern.nonzero(i,j) && std::abs(trace(i,j)) > pattern.tolerance*largest)
+            {
+                std::cout << "Warning: four quark entry (" << i << "," << j << ") = " << trace(i,j) << " outside the mixing pattern, largest entry " << largest << std::endl;
+            }
+        }
+        // checked only, the result keeps the pattern's zeros
+        for(int i=0;i<trace.rows();i++)
+        for(int j=0;j<trace.cols();j++)
+        {
+            if(!pattern.nonzero(i,j)){ trace(i,j) = 0; }
+        }
     }
     return trace;
 }
 
-Distribution<Eigen::MatrixXd> projectFourQuark(Distribution<Grid::QCD::SpinColourMatrix> prop1, Distribution<Grid::QCD::SpinColourMatrix> prop2, Distribution<std::vector<Grid::QCD::SpinColourSpinColourMatrix>> vertices, std::vector<DiracStructure> vertex_structure,std::vector<DiracStructure> projector, std::vector<bool> colourMix)
+Eigen::MatrixXd projectFourQuark(Grid::QCD::SpinColourMatrix prop1, Grid::QCD::SpinColourMatrix prop2, std::vector<Grid::QCD::SpinColourSpinColourMatrix> vertices, std::vector<DiracStructure> vertex_structure,std::vector<DiracStructure> projector, std::vector<bool> colourMix, const MixingPattern &pattern = MixingPattern())
+{
+    FourQuarkVertex vertex(vertices,vertex_structure);
+    return projectFourQuark(vertex,invert(prop1),invert(prop2),projector,colourMix,pattern);
+}
+
+Real projectFourQuark(Grid::QCD::SpinColourMatrix prop1, Grid::QCD::SpinColourMatrix prop2, std::vector<Grid::QCD::SpinColourSpinColourMatrix> vertices, DiracStructure vertex_structure,DiracStructure projector, bool colourMix)
+{
+    std::vector<DiracStructure> vs = {vertex_structure};
+    std::vector<DiracStructure> ps = {projector};
+    return projectFourQuark(prop1,prop2,vertices,vs,ps,std::vector<bool>(1,colourMix))(0,0);
+}
+
+Distribution<Eigen::MatrixXd> projectFourQuark(Distribution<Grid::QCD::SpinColourMatrix> prop1, Distribution<Grid::QCD::SpinColourMatrix> prop2, Distribution<std::vector<Grid::QCD::SpinColourSpinColourMatrix>> vertices, std::vector<DiracStructure> vertex_structure,std::vector<DiracStructure> projector, std::vector<bool> colourMix, const MixingPattern &pattern = MixingPattern())
 {
     int nSamples = prop1.size();
     std::vector<Eigen::MatrixXd> trace(nSamples,Eigen::MatrixXd(vertex_structure.size(),projector.size()));
@@ -171,12 +350,57 @@ Distribution<Eigen::MatrixXd> projectFourQuark(Distribution<Grid::QCD::SpinColou
 
     for(int i=0;i<nSamples;i++)
     {
-        trace[i] = projectFourQuark(prop1.get_value(i),prop2.get_value(i),vertices.get_value(i),vertex_structure,projector,colourMix);
+        trace[i] = projectFourQuark(prop1.get_value(i),prop2.get_value(i),vertices.get_value(i),vertex_structure,projector,colourMix,pattern);
+    }
+
+    // central value is the last sample, pattern warnings already given
+    if(fourquark_mixed_precision())
+    {
+        MixingPattern quiet = pattern;
+        quiet.check         = false;
+        FourQuarkVertex exact(vertices.get_value(nSamples-1),vertex_structure,false);
+        fourquark_mixed_report(trace[nSamples-1],projectFourQuark(exact,invert(prop1.get_value(nSamples-1)),invert(prop2.get_value(nSamples-1)),projector,colourMix,quiet));
     }
     return Distribution<Eigen::MatrixXd>(trace);
 
 }
 
+// several projector sets (e.g. gamma and qslash) sharing the summed vertex of each sample
+std::vector<Distribution<Eigen::MatrixXd>> projectFourQuark(Distribution<Grid::QCD::SpinColourMatrix> prop1, Distribution<Grid::QCD::SpinColourMatrix> prop2, Distribution<std::vector<Grid::QCD::SpinColourSpinColourMatrix>> vertices, std::vector<DiracStructure> vertex_structure,std::vector<std::vector<DiracStructure>> projectors, std::vector<std::vector<bool>> colourMix, const MixingPattern &pattern = MixingPattern())
+{
+    int nSamples = prop1.size();
+    std::vector<std::vector<Eigen::MatrixXd>> trace(projectors.size(),std::vector<Eigen::MatrixXd>(nSamples));
+
+    for(int i=0;i<nSamples;i++)
+    {
+        FourQuarkVertex vertex(vertices.get_value(i),vertex_structure);
+        auto propInv1 = invert(prop1.get_value(i));
+        auto propInv2 = invert(prop2.get_value(i));
+        for(int k=0;k<projectors.size();k++)
+        {
+            trace[k][i] = projectFourQuark(vertex,propInv1,propInv2,projectors[k],colourMix[k],pattern);
+        }
+    }
+
+    // central value is the last sample, pattern warnings already given
+    if(fourquark_mixed_precision())
+    {
+        MixingPattern quiet = pattern;
+        quiet.check         = false;
+        FourQuarkVertex exact(vertices.get_value(nSamples-1),vertex_structure,false);
+        auto propInv1 = invert(prop1.get_value(nSamples-1));
+        auto propInv2 = invert(prop2.get_value(nSamples-1));
+        for(int k=0;k<projectors.size();k++)
+        {
+            fourquark_mixed_report(trace[k][nSamples-1],projectFourQuark(exact,propInv1,propInv2,projectors[k],colourMix[k],quiet));
+        }
+    }
+
+    std::vector<Distribution<Eigen::MatrixXd>> result;
+    for(auto tr : trace){ result.push_back(Distribution<Eigen::MatrixXd>(tr)); }
+    return result;
+}
+
 Distribution<Real> projectFourQuark(Distribution<Grid::QCD::SpinColourMatrix> prop1, Distribution<Grid::QCD::SpinColourMatrix> prop2, Distribution<std::vector<Grid::QCD::SpinColourSpinColourMatrix>> vertices, DiracStructure vertex_structure,DiracStructure projector, bool colourMix)
 {
     int nSamples = prop1.size();
@@ -192,28 +416,36 @@ Distribution<Real> projectFourQuark(Distribution<Grid::QCD::SpinColourMatrix> pr
 }
 
 
+// figure8 and circle as dot products of the colour/spin traces with their transposes
 ComplexD projMix(SpinColourMatrix vertex, SpinColourMatrix leg)
 {
     ComplexD    figure8;
     ComplexD    circle;
 
-    SpinMatrix      tr_c = traceIndex<ColourIndex>(leg*vertex);
-    ColourMatrix    tr_s = traceIndex<SpinIndex>(leg*vertex);
+    SpinColourMatrix lv = leg*vertex;
+    SpinMatrix      tr_c;
+    ColourMatrix    tr_s;
+    Contraction<Layout<SpinIndexLabel<'s'>,SpinIndexLabel<'t'>>,SpinColourLayout<'s','t','a','a'>>::assign(&tr_c()(0,0)(),{&lv()(0,0)(0,0)});
+    Contraction<Layout<ColourIndexLabel<'a'>,ColourIndexLabel<'b'>>,SpinColourLayout<'s','s','a','b'>>::assign(&tr_s()()(0,0),{&lv()(0,0)(0,0)});
 
-    figure8     = traceIndex<ColourIndex>(tr_s*tr_s);
-    circle      = traceIndex<SpinIndex>(tr_c*tr_c);
-            
+    figure8     = fourquark_dot(&tr_s()()(0,0),&tr_s()()(0,0),Grid::QCD::Nc*Grid::QCD::Nc,Grid::QCD::Nc);
+    circle      = fourquark_dot(&tr_c()(0,0)(),&tr_c()(0,0)(),Grid::QCD::Ns*Grid::QCD::Ns,Grid::QCD::Ns);
 
     return figure8 - circle;
 }
 
+// circle = sum_ij P_ij P_ji with P = leg*vertex, the transpose taken in the paired index order
 ComplexD projUnmix(SpinColourMatrix vertex, SpinColourMatrix leg)
 {
     ComplexD    figure8;
     ComplexD    circle;
 
-    figure8 = trace(leg*vertex)*trace(leg*vertex);
-    circle  = trace(leg*vertex*leg*vertex);
+    SpinColourMatrix lv = leg*vertex;
+    Eigen::VectorXcd lvT(FourQuarkUnmixed::size);
+    FourQuarkUnmixed::leg(&lv()(0,0)(0,0),lvT.data());
+
+    figure8 = trace(lv)*trace(lv);
+    circle  = fourquark_dot(&lv()(0,0)(0,0),lvT.data(),FourQuarkUnmixed::size);
 
     return figure8 - circle;
 }
@@ -240,6 +472,72 @@ Real projectTree(DiracStructure vertex_structure, DiracStructure projector, bool
     return round(real(tr));
 }
 
+////////////////////////////////////
+//  Tree level projection at compile time
+//
+//      For gammas without momentum dependence the tree level vertex is Gamma x 1_colour, so
+//      with X = P*Gamma the traces reduce to spin traces of basis elements
+//          unmixed:    Nc^2 tr(X)^2 - Nc tr(XX)        mixed:  Nc tr(X)^2 - Nc^2 tr(XX)
+//      tr(i^k B) = 4 i^k for the identity and 0 otherwise, so everything is an integer.
+////////////////////////////////////
+struct DiracStructureSpec{
+    int n;
+    int gammas[8];  // Gamma::Algebra
+    int signs[8];
+};
+
+template<int nOp>
+struct FourQuarkTree{
+    long value[nOp][nOp];
+};
+
+// tr(i^phase B_index) as (re,im)
+constexpr void tree_trace(int index, int phase, long &re, long &im)
+{
+    const long unit[4][2] = {{1,0},{0,1},{-1,0},{0,-1}};
+    bool identity = (index == int(Gamma::Algebra::Identity)/2);
+    re = identity ? 4*unit[phase&3][0] : 0;
+    im = identity ? 4*unit[phase&3][1] : 0;
+}
+
+template<int nOp>
+constexpr FourQuarkTree<nOp> four_quark_tree(const DiracStructureSpec (&vertex)[nOp], const DiracStructureSpec (&projector)[nOp], const bool (&colourMix)[nOp], int nc)
+{
+    FourQuarkTree<nOp> tree{};
+    for(int i=0;i<nOp;i++)
+    for(int j=0;j<nOp;j++)
+    for(int nu=0;nu<vertex[i].n;nu++)
+    for(int mu=0;mu<projector[j].n;mu++)
+    {
+        // X = P*Gamma and XX, Algebra a -> index a/2 with phase 0 (odd) or 2 (Minus, even)
+        int p       = projector[j].gammas[mu];
+        int g       = vertex[i].gammas[nu];
+        int x       = SparseGamma::table.product[p/2][g/2];
+        int xphase  = (p%2 ? 0 : 2) + (g%2 ? 0 : 2) + SparseGamma::table.phase[p/2][g/2];
+        int xx      = SparseGamma::table.product[x][x];
+        int xxphase = 2*xphase + SparseGamma::table.phase[x][x];
+
+        long trx_re = 0, trx_im = 0, trxx_re = 0, trxx_im = 0;
+        tree_trace(x,xphase,trx_re,trx_im);
+        tree_trace(xx,xxphase,trxx_re,trxx_im);
+        long trx_sq = trx_re*trx_re - trx_im*trx_im;
+
+        long proj = colourMix[j] ? nc*trx_sq - nc*nc*trxx_re : nc*nc*trx_sq - nc*trxx_re;
+        tree.value[i][j] += vertex[i].signs[nu]*projector[j].signs[mu]*2*proj;
+    }
+    return tree;
+}
 
+template<int nOp>
+Eigen::MatrixXd tree_matrix(const FourQuarkTree<nOp> &tree)
+{
+    Eigen::MatrixXd matrix(nOp,nOp);
+    for(int i=0;i<nOp;i++)
+    for(int j=0;j<nOp;j++)
+    {
+        matrix(i,j) = tree.value[i][j];
+    }
+    return matrix;
+}
 
 #endif
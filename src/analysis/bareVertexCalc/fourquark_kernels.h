@@ -0,0 +1,133 @@
+#ifndef FOURQUARK_KERNELS_H
+#define FOURQUARK_KERNELS_H
+
+#include "Grid/Grid.h"
+#include <Grid/Eigen/Core>
+#include <complex>
+#include <utility>
+#include <type_traits>
+#include <vector>
+#include "contraction.h"
+
+////////////////////////////////////
+//  Four quark contraction kernels
+//  Specialised at compile time on the colour mixing, Ns and Nc so every index
+//  permutation is a constant expression. The reorderings are Contraction specs.
+//  The kernels work on the flat memory of the Grid tensors:
+//      SpinColourMatrix            (s1,s2,c1,c2)               row major
+//      SpinColourSpinColourMatrix  (sa,sb,ca,cb,sc,sd,cc,cd)   row major
+//  See fourquark.h for the matrix form of the contractions.
+////////////////////////////////////
+
+// row major (Ns*Ns*Nc*Nc)^2 vertex matrix
+typedef Eigen::Matrix<Grid::ComplexD,Eigen::Dynamic,Eigen::Dynamic,Eigen::RowMajor> FourQuarkMatrix;
+
+// unrolled loop - f is called with std::integral_constant<int,i> for i = 0..N-1
+template<class F, int... I>
+inline void static_for_impl(F &&f, std::integer_sequence<int,I...>)
+{
+    int expand[] = {0, (f(std::integral_constant<int,I>()),0)...};
+    (void)expand;
+}
+
+template<int N, class F>
+inline void static_for(F &&f)
+{
+    static_for_impl(f,std::make_integer_sequence<int,N>());
+}
+
+// call f with std::true_type or std::false_type for the runtime colour mixing
+template<class F>
+inline void fourquark_dispatch(bool colourMix, F &&f)
+{
+    if(colourMix)   { f(std::true_type());  }
+    else            { f(std::false_type()); }
+}
+
+template<bool colourMix, int ns, int nc>
+struct FourQuarkKernel
+{
+    static constexpr int size = ns*ns*nc*nc;
+
+    static constexpr int pair(int s1, int s2, int c1, int c2){ return ((s1*ns+s2)*nc+c1)*nc+c2; }
+
+    template<char label> using S = Index<label,ns>;
+    template<char label> using C = Index<label,nc>;
+
+    // vertex (sa,sb,ca,cb,sc,sd,cc,cd) and its figure8 and circle pairings as (row,column)
+    typedef Layout<S<'a'>,S<'b'>,C<'A'>,C<'B'>,S<'c'>,S<'d'>,C<'C'>,C<'D'>>     VertexLayout;
+    typedef typename std::conditional<colourMix,
+        Layout<S<'a'>,S<'b'>,C<'A'>,C<'D'>,S<'c'>,S<'d'>,C<'C'>,C<'B'>>,
+        Layout<S<'a'>,S<'b'>,C<'A'>,C<'B'>,S<'c'>,S<'d'>,C<'C'>,C<'D'>>>::type   Figure8Layout;
+    typedef typename std::conditional<colourMix,
+        Layout<S<'a'>,S<'d'>,C<'A'>,C<'B'>,S<'c'>,S<'b'>,C<'C'>,C<'D'>>,
+        Layout<S<'a'>,S<'d'>,C<'A'>,C<'D'>,S<'c'>,S<'b'>,C<'C'>,C<'B'>>>::type   CircleLayout;
+
+    ///////////////////////////////////////////////
+    // leg as vector : out[(s1,s2,c1,c2)] = leg(s2,s1)(c2,c1)
+    ///////////////////////////////////////////////
+    static void leg(const Grid::ComplexD *leg, Grid::ComplexD *out)
+    {
+        Contraction<Layout<S<'a'>,S<'b'>,C<'A'>,C<'B'>>,Layout<S<'b'>,S<'a'>,C<'B'>,C<'A'>>>::assign(out,{leg});
+    }
+
+    ///////////////////////////////////////////////
+    // V_f8 - V_circ, matrix must be zero on entry
+    ///////////////////////////////////////////////
+    static void vertex_matrix(const Grid::ComplexD *vertex, Grid::ComplexD *matrix)
+    {
+        Contraction<Figure8Layout,VertexLayout>::accumulate(matrix,{vertex});
+        Contraction<CircleLayout,VertexLayout>::accumulate(matrix,{vertex},-1.);
+    }
+
+    ///////////////////////////////////////////////
+    // figure8-circle = l^T M l for every leg (column) l
+    ///////////////////////////////////////////////
+    static Eigen::VectorXcd contract(const FourQuarkMatrix &matrix, const Eigen::Matrix<Grid::ComplexD,size,Eigen::Dynamic> &legs)
+    {
+        Eigen::Map<const Eigen::Matrix<Grid::ComplexD,size,size,Eigen::RowMajor>> m(matrix.data());
+        Eigen::Matrix<Grid::ComplexD,size,Eigen::Dynamic> ml = m*legs;
+        return (legs.array()*ml.array()).colwise().sum().transpose();
+    }
+};
+
+////////////////////////////////////
+// out = sum_n signs[n] * in[n] over nGamma components of size elements
+////////////////////////////////////
+template<int nGamma>
+struct FourQuarkSum
+{
+    static void sum(const Grid::ComplexD *const *in, const int *signs, Grid::ComplexD *out, int size)
+    {
+        double s[nGamma];
+        static_for<nGamma>([&](auto n){ s[n] = signs[n]; });
+        for(int k=0;k<size;k++)
+        {
+            Grid::ComplexD acc = 0;
+            static_for<nGamma>([&](auto n){ acc += s[n]*in[n][k]; });
+            out[k] = acc;
+        }
+    }
+};
+
+// runtime structure length -> FourQuarkSum instantiation ( lengths of the gamma basis )
+inline void fourquark_signed_sum(const std::vector<const Grid::ComplexD *> &in, const std::vector<int> &signs, Grid::ComplexD *out, int size)
+{
+    switch(in.size())
+    {
+        case 1:     FourQuarkSum<1>::sum(in.data(),signs.data(),out,size);  break;
+        case 2:     FourQuarkSum<2>::sum(in.data(),signs.data(),out,size);  break;
+        case 4:     FourQuarkSum<4>::sum(in.data(),signs.data(),out,size);  break;
+        case 6:     FourQuarkSum<6>::sum(in.data(),signs.data(),out,size);  break;
+        case 8:     FourQuarkSum<8>::sum(in.data(),signs.data(),out,size);  break;
+        default:
+            for(int k=0;k<size;k++)
+            {
+                Grid::ComplexD acc = 0;
+                for(int n=0;n<in.size();n++){ acc += double(signs[n])*in[n][k]; }
+                out[k] = acc;
+            }
+    }
+}
+
+#endif
@@ -0,0 +1,185 @@
+#ifndef FOURQUARK_MIXED_H
+#define FOURQUARK_MIXED_H
+
+#include "Grid/Grid.h"
+#include <Grid/Eigen/Core>
+#include <vector>
+#include "fourquark_simd.h"
+
+////////////////////////////////////
+//  Mixed precision four quark contractions
+//
+//      Vertex matrices and legs are stored in single precision, halving the memory traffic
+//      of the contraction. Each product of two floats is exact in double and is accumulated
+//      in double with Kahan compensation, both within the row dot products and over the
+//      rows. The same (re,im) interleaved / split duplicated layout as the double kernels.
+//      Compensation relies on value safe floating point, so the kernels are compiled
+//      between FOURQUARK_PRECISE_BEGIN/END.
+////////////////////////////////////
+
+typedef Eigen::Matrix<Grid::ComplexF,Eigen::Dynamic,Eigen::Dynamic,Eigen::RowMajor> FourQuarkMatrixF;
+
+typedef Grid::ComplexD (*FourQuarkDotMixed)(const Grid::ComplexF *a, const float *bre, const float *bim, int n);
+
+// off by default, set from the input before any vertex is built
+bool & fourquark_mixed_precision()
+{
+    static bool mixed = false;
+    return mixed;
+}
+
+FOURQUARK_PRECISE_BEGIN
+
+inline void kahan_add(double &sum, double &comp, double x)
+{
+    double y = x - comp;
+    double t = sum + y;
+    comp = (t - sum) - y;
+    sum  = t;
+}
+
+///////////////////////////////////////////////
+// remainder ( the whole row for the scalar kernel ) and horizontal sum of W compensated lanes
+///////////////////////////////////////////////
+template<int W>
+inline Grid::ComplexD fourquark_dot_mixed_finish(const float *a, const float *bre, const float *bim, int rem, double *s1, double *c1, double *s2, double *c2)
+{
+    // W is even so lane j%W keeps the re/im parity of j
+    for(int j=0;j<rem;j++)
+    {
+        kahan_add(s1[j%W],c1[j%W],double(a[j])*double(bre[j]));
+        kahan_add(s2[j%W],c2[j%W],double(a[j])*double(bim[j]));
+    }
+    double re = 0, im = 0;
+    for(int j=0;j<W;j+=2)
+    {
+        re += (s1[j]   - c1[j])   - (s2[j+1] - c2[j+1]);
+        im += (s1[j+1] - c1[j+1]) + (s2[j]   - c2[j]);
+    }
+    return Grid::ComplexD(re,im);
+}
+
+Grid::ComplexD fourquark_dot_mixed_scalar(const Grid::ComplexF *a, const float *bre, const float *bim, int n)
+{
+    double s1[2] = {0}, c1[2] = {0}, s2[2] = {0}, c2[2] = {0};
+    return fourquark_dot_mixed_finish<2>(reinterpret_cast<const float *>(a),bre,bim,2*n,s1,c1,s2,c2);
+}
+
+#ifdef FOURQUARK_X86
+__attribute__((target("avx2,fma")))
+Grid::ComplexD fourquark_dot_mixed_avx2(const Grid::ComplexF *a, const float *bre, const float *bim, int n)
+{
+    const float *x = reinterpret_cast<const float *>(a);
+    __m256d s1 = _mm256_setzero_pd(), c1 = _mm256_setzero_pd();
+    __m256d s2 = _mm256_setzero_pd(), c2 = _mm256_setzero_pd();
+    int nv = ((2*n)/4)*4;
+    for(int i=0;i<nv;i+=4)
+    {
+        __m256d v  = _mm256_cvtps_pd(_mm_loadu_ps(x+i));
+        __m256d p1 = _mm256_mul_pd(v,_mm256_cvtps_pd(_mm_loadu_ps(bre+i)));
+        __m256d p2 = _mm256_mul_pd(v,_mm256_cvtps_pd(_mm_loadu_ps(bim+i)));
+
+        __m256d y1 = _mm256_sub_pd(p1,c1);
+        __m256d t1 = _mm256_add_pd(s1,y1);
+        c1 = _mm256_sub_pd(_mm256_sub_pd(t1,s1),y1);
+        s1 = t1;
+
+        __m256d y2 = _mm256_sub_pd(p2,c2);
+        __m256d t2 = _mm256_add_pd(s2,y2);
+        c2 = _mm256_sub_pd(_mm256_sub_pd(t2,s2),y2);
+        s2 = t2;
+    }
+    alignas(32) double as1[4], ac1[4], as2[4], ac2[4];
+    _mm256_store_pd(as1,s1); _mm256_store_pd(ac1,c1);
+    _mm256_store_pd(as2,s2); _mm256_store_pd(ac2,c2);
+    return fourquark_dot_mixed_finish<4>(x+nv,bre+nv,bim+nv,2*n-nv,as1,ac1,as2,ac2);
+}
+
+__attribute__((target("avx512f")))
+Grid::ComplexD fourquark_dot_mixed_avx512(const Grid::ComplexF *a, const float *bre, const float *bim, int n)
+{
+    const float *x = reinterpret_cast<const float *>(a);
+    __m512d s1 = _mm512_setzero_pd(), c1 = _mm512_setzero_pd();
+    __m512d s2 = _mm512_setzero_pd(), c2 = _mm512_setzero_pd();
+    int nv = ((2*n)/8)*8;
+    for(int i=0;i<nv;i+=8)
+    {
+        __m512d v  = _mm512_cvtps_pd(_mm256_loadu_ps(x+i));
+        __m512d p1 = _mm512_mul_pd(v,_mm512_cvtps_pd(_mm256_loadu_ps(bre+i)));
+        __m512d p2 = _mm512_mul_pd(v,_mm512_cvtps_pd(_mm256_loadu_ps(bim+i)));
+
+        __m512d y1 = _mm512_sub_pd(p1,c1);
+        __m512d t1 = _mm512_add_pd(s1,y1);
+        c1 = _mm512_sub_pd(_mm512_sub_pd(t1,s1),y1);
+        s1 = t1;
+
+        __m512d y2 = _mm512_sub_pd(p2,c2);
+        __m512d t2 = _mm512_add_pd(s2,y2);
+        c2 = _mm512_sub_pd(_mm512_sub_pd(t2,s2),y2);
+        s2 = t2;
+    }
+    alignas(64) double as1[8], ac1[8], as2[8], ac2[8];
+    _mm512_store_pd(as1,s1); _mm512_store_pd(ac1,c1);
+    _mm512_store_pd(as2,s2); _mm512_store_pd(ac2,c2);
+    return fourquark_dot_mixed_finish<8>(x+nv,bre+nv,bim+nv,2*n-nv,as1,ac1,as2,ac2);
+}
+#endif
+
+FOURQUARK_PRECISE_END
+
+FourQuarkDotMixed fourquark_dot_mixed_kernel(FourQuarkISA isa)
+{
+#ifdef FOURQUARK_X86
+    if(isa == FourQuarkISA::avx512) { return fourquark_dot_mixed_avx512; }
+    if(isa == FourQuarkISA::avx2)   { return fourquark_dot_mixed_avx2;   }
+#endif
+    return fourquark_dot_mixed_scalar;
+}
+
+///////////////////////////////////////////////
+// figure8-circle = l^T M l for every leg l, M and l in single precision
+///////////////////////////////////////////////
+template<int size>
+Eigen::VectorXcd fourquark_contract_mixed(const FourQuarkMatrixF &matrix, const Eigen::Matrix<Grid::ComplexD,size,Eigen::Dynamic> &legs)
+{
+    FourQuarkDotMixed dot = fourquark_dot_mixed_kernel(fourquark_isa());
+
+    int nLegs = legs.cols();
+    Eigen::Matrix<Grid::ComplexF,size,Eigen::Dynamic> legsF = legs.template cast<Grid::ComplexF>();
+    std::vector<float> lre(2*size*nLegs), lim(2*size*nLegs);
+    for(int k=0;k<nLegs;k++)
+    for(int c=0;c<size;c++)
+    {
+        lre[2*size*k+2*c] = lre[2*size*k+2*c+1] = legsF(c,k).real();
+        lim[2*size*k+2*c] = lim[2*size*k+2*c+1] = legsF(c,k).imag();
+    }
+
+    std::vector<double> sum_re(nLegs,0), comp_re(nLegs,0), sum_im(nLegs,0), comp_im(nLegs,0);
+    for(int r=0;r<size;r++)
+    {
+        const Grid::ComplexF *row = matrix.data() + r*size;
+        for(int k=0;k<nLegs;k++)
+        {
+            Grid::ComplexD rowsum = dot(row,&lre[2*size*k],&lim[2*size*k],size);
+            Grid::ComplexD l(legsF(r,k).real(),legsF(r,k).imag());
+            kahan_add(sum_re[k],comp_re[k],l.real()*rowsum.real());
+            kahan_add(sum_re[k],comp_re[k],-l.imag()*rowsum.imag());
+            kahan_add(sum_im[k],comp_im[k],l.real()*rowsum.imag());
+            kahan_add(sum_im[k],comp_im[k],l.imag()*rowsum.real());
+        }
+    }
+
+    Eigen::VectorXcd contracted(nLegs);
+    for(int k=0;k<nLegs;k++){ contracted(k) = Grid::ComplexD(sum_re[k]-comp_re[k],sum_im[k]-comp_im[k]); }
+    return contracted;
+}
+
+// deviation of a mixed precision projection from the double precision one
+void fourquark_mixed_report(const Eigen::MatrixXd &mixed, const Eigen::MatrixXd &exact)
+{
+    double dev   = (mixed-exact).cwiseAbs().maxCoeff();
+    double scale = exact.cwiseAbs().maxCoeff();
+    std::cout << "mixed precision four quark: max deviation from double on central sample " << dev << " (relative " << dev/scale << ")" << std::endl;
+}
+
+#endif
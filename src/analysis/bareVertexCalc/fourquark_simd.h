@@ -0,0 +1,299 @@
+#ifndef FOURQUARK_SIMD_H
+#define FOURQUARK_SIMD_H
+
+#include "Grid/Grid.h"
+#include <Grid/Eigen/Core>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FOURQUARK_X86
+#endif
+#include "fourquark_kernels.h"
+
+// value safe floating point between BEGIN and END whatever the global flags ( icpc defaults to
+// -fp-model fast ), for code that depends on the order of its operations
+#if defined(__INTEL_COMPILER) || defined(__clang__)
+#define FOURQUARK_PRECISE_BEGIN _Pragma("float_control(precise,on,push)")
+#define FOURQUARK_PRECISE_END   _Pragma("float_control(pop)")
+#elif defined(__GNUC__)
+#define FOURQUARK_PRECISE_BEGIN _Pragma("GCC push_options") _Pragma("GCC optimize(\"no-fast-math\")")
+#define FOURQUARK_PRECISE_END   _Pragma("GCC pop_options")
+#else
+#define FOURQUARK_PRECISE_BEGIN
+#define FOURQUARK_PRECISE_END
+#endif
+
+////////////////////////////////////
+//  Hand vectorised four quark contractions
+//
+//      The contraction and the figure8/circle traces are all unconjugated complex dot
+//      products sum_k a_k b_k. a is read as interleaved (re,im) doubles and b is passed
+//      split and duplicated
+//          bre = (re b_0, re b_0, re b_1, re b_1, ...)   bim = (im b_0, im b_0, ...)
+//      so each register needs two fmas and no shuffles
+//          acc1 += a*bre = (re a re b, im a re b)    acc2 += a*bim = (re a im b, im a im b)
+//      The instruction set is picked at run time from cpuid. The reference kernels repeat
+//      the lane order of each instruction set with std::fma so the results can be compared
+//      bit for bit; this needs value safe floating point, so all the kernels are compiled
+//      between FOURQUARK_PRECISE_BEGIN/END.
+////////////////////////////////////
+
+enum class FourQuarkISA { scalar, avx2, avx512 };
+
+typedef Grid::ComplexD (*FourQuarkDot)(const Grid::ComplexD *a, const double *bre, const double *bim, int n);
+
+std::string fourquark_isa_name(FourQuarkISA isa)
+{
+    switch(isa)
+    {
+        case FourQuarkISA::avx512:  return "avx512";
+        case FourQuarkISA::avx2:    return "avx2";
+        default:                    return "scalar";
+    }
+}
+
+bool fourquark_isa_supported(FourQuarkISA isa)
+{
+#ifdef FOURQUARK_X86
+    switch(isa)
+    {
+        case FourQuarkISA::avx512:  return __builtin_cpu_supports("avx512f");
+        case FourQuarkISA::avx2:    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        default:                    return true;
+    }
+#else
+    return isa == FourQuarkISA::scalar;
+#endif
+}
+
+// instruction set in use, initialised to the widest supported
+FourQuarkISA & fourquark_isa()
+{
+    static FourQuarkISA isa = fourquark_isa_supported(FourQuarkISA::avx512) ? FourQuarkISA::avx512 :
+                              fourquark_isa_supported(FourQuarkISA::avx2)   ? FourQuarkISA::avx2   : FourQuarkISA::scalar;
+    return isa;
+}
+
+FOURQUARK_PRECISE_BEGIN
+
+// a*b + c with the rounding fixed by explicit fmas
+inline Grid::ComplexD fourquark_cmadd(Grid::ComplexD a, Grid::ComplexD b, Grid::ComplexD c)
+{
+    double re = std::fma( a.real(),b.real(),std::fma(-a.imag(),b.imag(),c.real()));
+    double im = std::fma( a.real(),b.imag(),std::fma( a.imag(),b.real(),c.imag()));
+    return Grid::ComplexD(re,im);
+}
+
+///////////////////////////////////////////////
+// b -> split, duplicated layout. transposed as a square ncol x ncol matrix if ncol > 0
+///////////////////////////////////////////////
+void fourquark_split(const Grid::ComplexD *b, int n, double *bre, double *bim, int ncol=0)
+{
+    for(int k=0;k<n;k++)
+    {
+        int src = (ncol > 0) ? (k%ncol)*ncol + k/ncol : k;
+        bre[2*k] = bre[2*k+1] = b[src].real();
+        bim[2*k] = bim[2*k+1] = b[src].imag();
+    }
+}
+
+///////////////////////////////////////////////
+// remainder of the vector loop and the horizontal sum over W lanes,
+// shared by all kernels so only the vector loop differs
+///////////////////////////////////////////////
+template<int W>
+inline Grid::ComplexD fourquark_dot_finish(const double *a, const double *bre, const double *bim, int rem, double *acc1, double *acc2)
+{
+    for(int j=0;j<rem;j++)
+    {
+        acc1[j] = std::fma(a[j],bre[j],acc1[j]);
+        acc2[j] = std::fma(a[j],bim[j],acc2[j]);
+    }
+    double re = 0, im = 0;
+    for(int j=0;j<W;j+=2)
+    {
+        re += acc1[j];
+        re -= acc2[j+1];
+        im += acc1[j+1];
+        im += acc2[j];
+    }
+    return Grid::ComplexD(re,im);
+}
+
+// lane order of a W wide register in scalar code
+template<int W>
+Grid::ComplexD fourquark_dot_reference(const Grid::ComplexD *a, const double *bre, const double *bim, int n)
+{
+    const double *x = reinterpret_cast<const double *>(a);
+    double acc1[W] = {0}, acc2[W] = {0};
+    int nv = ((2*n)/W)*W;
+    for(int i=0;i<nv;i+=W)
+    for(int j=0;j<W;j++)
+    {
+        acc1[j] = std::fma(x[i+j],bre[i+j],acc1[j]);
+        acc2[j] = std::fma(x[i+j],bim[i+j],acc2[j]);
+    }
+    return fourquark_dot_finish<W>(x+nv,bre+nv,bim+nv,2*n-nv,acc1,acc2);
+}
+
+#ifdef FOURQUARK_X86
+__attribute__((target("avx2,fma")))
+Grid::ComplexD fourquark_dot_avx2(const Grid::ComplexD *a, const double *bre, const double *bim, int n)
+{
+    const double *x = reinterpret_cast<const double *>(a);
+    __m256d acc1 = _mm256_setzero_pd();
+    __m256d acc2 = _mm256_setzero_pd();
+    int nv = ((2*n)/4)*4;
+    for(int i=0;i<nv;i+=4)
+    {
+        __m256d v = _mm256_loadu_pd(x+i);
+        acc1 = _mm256_fmadd_pd(v,_mm256_loadu_pd(bre+i),acc1);
+        acc2 = _mm256_fmadd_pd(v,_mm256_loadu_pd(bim+i),acc2);
+    }
+    alignas(32) double a1[4], a2[4];
+    _mm256_store_pd(a1,acc1);
+    _mm256_store_pd(a2,acc2);
+    return fourquark_dot_finish<4>(x+nv,bre+nv,bim+nv,2*n-nv,a1,a2);
+}
+
+__attribute__((target("avx512f")))
+Grid::ComplexD fourquark_dot_avx512(const Grid::ComplexD *a, const double *bre, const double *bim, int n)
+{
+    const double *x = reinterpret_cast<const double *>(a);
+    __m512d acc1 = _mm512_setzero_pd();
+    __m512d acc2 = _mm512_setzero_pd();
+    int nv = ((2*n)/8)*8;
+    for(int i=0;i<nv;i+=8)
+    {
+        __m512d v = _mm512_loadu_pd(x+i);
+        acc1 = _mm512_fmadd_pd(v,_mm512_loadu_pd(bre+i),acc1);
+        acc2 = _mm512_fmadd_pd(v,_mm512_loadu_pd(bim+i),acc2);
+    }
+    alignas(64) double a1[8], a2[8];
+    _mm512_store_pd(a1,acc1);
+    _mm512_store_pd(a2,acc2);
+    return fourquark_dot_finish<8>(x+nv,bre+nv,bim+nv,2*n-nv,a1,a2);
+}
+#endif
+
+FourQuarkDot fourquark_dot_kernel(FourQuarkISA isa)
+{
+#ifdef FOURQUARK_X86
+    if(isa == FourQuarkISA::avx512) { return fourquark_dot_avx512; }
+    if(isa == FourQuarkISA::avx2)   { return fourquark_dot_avx2;   }
+#endif
+    return fourquark_dot_reference<2>;
+}
+
+FourQuarkDot fourquark_dot_reference_kernel(FourQuarkISA isa)
+{
+    if(isa == FourQuarkISA::avx512) { return fourquark_dot_reference<8>; }
+    if(isa == FourQuarkISA::avx2)   { return fourquark_dot_reference<4>; }
+    return fourquark_dot_reference<2>;
+}
+
+///////////////////////////////////////////////
+// sum_k a_k b_k, b transposed as a square ncol x ncol matrix if ncol > 0
+// n is at most one row of the vertex, so the split b lives on the stack
+///////////////////////////////////////////////
+Grid::ComplexD fourquark_dot(const Grid::ComplexD *a, const Grid::ComplexD *b, int n, int ncol=0, FourQuarkDot dot=nullptr)
+{
+    const int max = FourQuarkKernel<false,Grid::QCD::Ns,Grid::QCD::Nc>::size;
+    if(n > max)
+    {
+        std::cout << "Error: fourquark_dot of length " << n << " exceeds " << max << std::endl;
+        exit(1);
+    }
+    double bre[2*max], bim[2*max];
+    fourquark_split(b,n,bre,bim,ncol);
+    if(dot == nullptr){ dot = fourquark_dot_kernel(fourquark_isa()); }
+    return dot(a,bre,bim,n);
+}
+
+///////////////////////////////////////////////
+// figure8-circle = l^T M l for every leg (column) l, through the given dot kernel
+///////////////////////////////////////////////
+template<int size>
+Eigen::VectorXcd fourquark_contract(FourQuarkDot dot, const FourQuarkMatrix &matrix, const Eigen::Matrix<Grid::ComplexD,size,Eigen::Dynamic> &legs)
+{
+    int nLegs = legs.cols();
+    std::vector<double> lre(2*size*nLegs), lim(2*size*nLegs);
+    for(int k=0;k<nLegs;k++){ fourquark_split(legs.col(k).data(),size,&lre[2*size*k],&lim[2*size*k]); }
+
+    Eigen::VectorXcd contracted = Eigen::VectorXcd::Zero(nLegs);
+    for(int r=0;r<size;r++)
+    {
+        const Grid::ComplexD *row = matrix.data() + r*size;
+        for(int k=0;k<nLegs;k++)
+        {
+            Grid::ComplexD rowsum = dot(row,&lre[2*size*k],&lim[2*size*k],size);
+            contracted(k) = fourquark_cmadd(legs(r,k),rowsum,contracted(k));
+        }
+    }
+    return contracted;
+}
+
+FOURQUARK_PRECISE_END
+
+// instruction set in use, Eigen for scalar
+template<int size>
+Eigen::VectorXcd fourquark_contract(const FourQuarkMatrix &matrix, const Eigen::Matrix<Grid::ComplexD,size,Eigen::Dynamic> &legs)
+{
+    FourQuarkISA isa = fourquark_isa();
+    if(isa == FourQuarkISA::scalar){ return FourQuarkKernel<false,Grid::QCD::Ns,Grid::QCD::Nc>::contract(matrix,legs); }
+    return fourquark_contract<size>(fourquark_dot_kernel(isa),matrix,legs);
+}
+
+////////////////////////////////////
+//  Check every supported instruction set bit for bit against its reference on random
+//  data, and against Eigen to rounding. Instruction sets that fail are not used and the
+//  check returns false.
+////////////////////////////////////
+bool fourquark_simd_check(int nLegs=4)
+{
+    const int size = FourQuarkKernel<false,Grid::QCD::Ns,Grid::QCD::Nc>::size;
+    std::mt19937                            gen(1234);
+    std::uniform_real_distribution<double>  uniform(-1,1);
+
+    FourQuarkMatrix                                         matrix(size,size);
+    Eigen::Matrix<Grid::ComplexD,size,Eigen::Dynamic>       legs(size,nLegs);
+    for(int i=0;i<matrix.size();i++){ matrix.data()[i] = Grid::ComplexD(uniform(gen),uniform(gen)); }
+    for(int i=0;i<legs.size();i++)  { legs.data()[i]   = Grid::ComplexD(uniform(gen),uniform(gen)); }
+
+    Eigen::VectorXcd eigen = FourQuarkKernel<false,Grid::QCD::Ns,Grid::QCD::Nc>::contract(matrix,legs);
+
+    bool pass = true;
+    bool ok[3] = {true,false,false};
+    for(FourQuarkISA isa : {FourQuarkISA::avx2,FourQuarkISA::avx512})
+    {
+        if(!fourquark_isa_supported(isa)){ continue; }
+        FourQuarkDot simd = fourquark_dot_kernel(isa);
+        FourQuarkDot ref  = fourquark_dot_reference_kernel(isa);
+
+        Eigen::VectorXcd vec = fourquark_contract<size>(simd,matrix,legs);
+        Eigen::VectorXcd sca = fourquark_contract<size>(ref,matrix,legs);
+        bool exact = (std::memcmp(vec.data(),sca.data(),nLegs*sizeof(Grid::ComplexD)) == 0);
+
+        // odd lengths exercise the remainder loop ( colour and spin traces of projMix )
+        for(int n : {Grid::QCD::Nc*Grid::QCD::Nc,Grid::QCD::Ns*Grid::QCD::Ns,size})
+        {
+            Grid::ComplexD d1 = fourquark_dot(matrix.data(),legs.data(),n,0,simd);
+            Grid::ComplexD d2 = fourquark_dot(matrix.data(),legs.data(),n,0,ref);
+            exact = exact && (std::memcmp(&d1,&d2,sizeof(Grid::ComplexD)) == 0);
+        }
+        double diff = (vec-eigen).norm()/eigen.norm();
+
+        std::cout << "fourquark " << fourquark_isa_name(isa) << " kernel: bitwise " << (exact ? "match" : "MISMATCH") << ", rel diff to eigen " << diff << std::endl;
+        ok[int(isa)] = exact && diff < 1e-12;
+        pass = pass && ok[int(isa)];
+    }
+    if(!ok[int(fourquark_isa())]){ fourquark_isa() = ok[int(FourQuarkISA::avx2)] ? FourQuarkISA::avx2 : FourQuarkISA::scalar; }
+    std::cout << "fourquark contractions use " << fourquark_isa_name(fourquark_isa()) << std::endl;
+    return pass;
+}
+
+#endif
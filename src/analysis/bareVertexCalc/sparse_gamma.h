@@ -0,0 +1,263 @@
+#ifndef SPARSE_GAMMA_H
+#define SPARSE_GAMMA_H
+
+#include "Grid/Grid.h"
+#include <iostream>
+
+////////////////////////////////////
+//  Gamma matrices as phased permutations
+//
+//      Every element of the Euclidean gamma basis has a single non-zero i^phase[r] in
+//      column perm[r] of each row r, so multiplying by one is a remap of the spin index and
+//      a phase, with no flops. The 16 elements follow the order of Gamma::Algebra / 2, with
+//      the Grid conventions ( chiral basis, GammaMuGamma5 = gmu*g5, SigmaMuNu = gmu*gnu );
+//      the product table B_i B_j = i^phase B_k is built at compile time from them and
+//      sparse_gamma_check() verifies both against Grid's dense Gamma at run time.
+////////////////////////////////////
+
+struct SparseGammaElement
+{
+    int perm[4];
+    int phase[4];
+};
+
+constexpr SparseGammaElement sparse_gamma_product(const SparseGammaElement &a, const SparseGammaElement &b)
+{
+    SparseGammaElement c{};
+    for(int r=0;r<4;r++)
+    {
+        c.perm[r]   = b.perm[a.perm[r]];
+        c.phase[r]  = (a.phase[r] + b.phase[a.perm[r]])%4;
+    }
+    return c;
+}
+
+struct SparseGammaTable
+{
+    static constexpr int nGamma = 16;
+
+    SparseGammaElement  element[nGamma];
+    int                 product[nGamma][nGamma];
+    int                 phase[nGamma][nGamma];
+};
+
+constexpr SparseGammaTable make_sparse_gamma_table()
+{
+    constexpr SparseGammaElement id = {{0,1,2,3},{0,0,0,0}};
+    constexpr SparseGammaElement gx = {{3,2,1,0},{1,1,3,3}};
+    constexpr SparseGammaElement gy = {{3,2,1,0},{2,0,0,2}};
+    constexpr SparseGammaElement gz = {{2,3,0,1},{1,3,3,1}};
+    constexpr SparseGammaElement gt = {{2,3,0,1},{0,0,0,0}};
+    constexpr SparseGammaElement g5 = {{0,1,2,3},{0,0,2,2}};
+
+    SparseGammaTable t{};
+    // Gamma5, GammaT, GammaTGamma5, GammaX, GammaXGamma5, GammaY, GammaYGamma5, GammaZ, GammaZGamma5,
+    // Identity, SigmaXT, SigmaXY, SigmaXZ, SigmaYT, SigmaYZ, SigmaZT
+    const SparseGammaElement basis[SparseGammaTable::nGamma] = {
+        g5, gt, sparse_gamma_product(gt,g5), gx, sparse_gamma_product(gx,g5), gy, sparse_gamma_product(gy,g5),
+        gz, sparse_gamma_product(gz,g5), id, sparse_gamma_product(gx,gt), sparse_gamma_product(gx,gy),
+        sparse_gamma_product(gx,gz), sparse_gamma_product(gy,gt), sparse_gamma_product(gy,gz), sparse_gamma_product(gz,gt)};
+
+    for(int i=0;i<SparseGammaTable::nGamma;i++){ t.element[i] = basis[i]; }
+
+    // the product matches exactly one element up to an overall phase
+    for(int i=0;i<SparseGammaTable::nGamma;i++)
+    for(int j=0;j<SparseGammaTable::nGamma;j++)
+    {
+        SparseGammaElement p = sparse_gamma_product(basis[i],basis[j]);
+        for(int k=0;k<SparseGammaTable::nGamma;k++)
+        {
+            bool match  = true;
+            int  shift  = (p.phase[0] - basis[k].phase[0] + 4)%4;
+            for(int r=0;r<4;r++)
+            {
+                match = match && (p.perm[r] == basis[k].perm[r]) && ((p.phase[r] - basis[k].phase[r] + 4)%4 == shift);
+            }
+            if(match)
+            {
+                t.product[i][j] = k;
+                t.phase[i][j]   = shift;
+            }
+        }
+    }
+    return t;
+}
+
+// z * i^k without multiplications
+inline Grid::ComplexD times_i_pow(const Grid::ComplexD &z, int k)
+{
+    switch(k&3)
+    {
+        case 1:     return Grid::ComplexD(-z.imag(), z.real());
+        case 2:     return Grid::ComplexD(-z.real(),-z.imag());
+        case 3:     return Grid::ComplexD( z.imag(),-z.real());
+        default:    return z;
+    }
+}
+
+////////////////////////////////////
+//  i^phase * B_index
+////////////////////////////////////
+class SparseGamma
+{
+    public:
+        static constexpr SparseGammaTable table = make_sparse_gamma_table();
+
+        int index;
+        int phase;
+
+        SparseGamma(int index=9, int phase=0) : index(index), phase(phase&3) {}
+        // Algebra pairs MinusX (even) and X (odd)
+        SparseGamma(Grid::QCD::Gamma::Algebra g) : index(int(g)/2), phase((int(g)%2) ? 0 : 2) {}
+
+        int                 perm(int r)  const { return table.element[index].perm[r]; }
+        int                 coeff(int r) const { return phase + table.element[index].phase[r]; }
+        Grid::QCD::SpinMatrix dense() const;
+};
+
+constexpr SparseGammaTable SparseGamma::table;
+
+SparseGamma operator*(const SparseGamma &a, const SparseGamma &b)
+{
+    return SparseGamma(SparseGamma::table.product[a.index][b.index],a.phase + b.phase + SparseGamma::table.phase[a.index][b.index]);
+}
+
+///////////////////////////////////////////////
+// row/column remap of a flat spin matrix with inner elements of size inner
+//      (G m)(r,s) = i^coeff(r) m(perm(r),s)      (m G)(s,perm(t)) = m(s,t) i^coeff(t)
+///////////////////////////////////////////////
+template<int inner>
+void sparse_gamma_left(const SparseGamma &g, const Grid::ComplexD *m, Grid::ComplexD *out)
+{
+    for(int r=0;r<4;r++)
+    for(int s=0;s<4;s++)
+    for(int k=0;k<inner;k++)
+    {
+        out[(r*4+s)*inner+k] = times_i_pow(m[(g.perm(r)*4+s)*inner+k],g.coeff(r));
+    }
+}
+
+template<int inner>
+void sparse_gamma_right(const Grid::ComplexD *m, const SparseGamma &g, Grid::ComplexD *out)
+{
+    for(int s=0;s<4;s++)
+    for(int t=0;t<4;t++)
+    for(int k=0;k<inner;k++)
+    {
+        out[(s*4+g.perm(t))*inner+k] = times_i_pow(m[(s*4+t)*inner+k],g.coeff(t));
+    }
+}
+
+Grid::QCD::SpinMatrix SparseGamma::dense() const
+{
+    Grid::QCD::SpinMatrix rho;
+    rho = rho + Grid::Complex(1.0,0);
+    Grid::QCD::SpinMatrix out;
+    sparse_gamma_left<1>(*this,&rho()(0,0)(),&out()(0,0)());
+    return out;
+}
+
+Grid::QCD::SpinMatrix operator*(const Grid::QCD::SpinMatrix &m, const SparseGamma &g)
+{
+    Grid::QCD::SpinMatrix out;
+    sparse_gamma_right<1>(&m()(0,0)(),g,&out()(0,0)());
+    return out;
+}
+
+Grid::QCD::SpinMatrix operator*(const SparseGamma &g, const Grid::QCD::SpinMatrix &m)
+{
+    Grid::QCD::SpinMatrix out;
+    sparse_gamma_left<1>(g,&m()(0,0)(),&out()(0,0)());
+    return out;
+}
+
+Grid::QCD::SpinColourMatrix operator*(const Grid::QCD::SpinColourMatrix &m, const SparseGamma &g)
+{
+    Grid::QCD::SpinColourMatrix out;
+    sparse_gamma_right<Grid::QCD::Nc*Grid::QCD::Nc>(&m()(0,0)(0,0),g,&out()(0,0)(0,0));
+    return out;
+}
+
+Grid::QCD::SpinColourMatrix operator*(const SparseGamma &g, const Grid::QCD::SpinColourMatrix &m)
+{
+    Grid::QCD::SpinColourMatrix out;
+    sparse_gamma_left<Grid::QCD::Nc*Grid::QCD::Nc>(g,&m()(0,0)(0,0),&out()(0,0)(0,0));
+    return out;
+}
+
+// tr( m * g ) over spin and colour = sum_t i^coeff(t) tr_c m(perm(t),t), 4 colour traces and no products
+Grid::ComplexD sparse_gamma_trace(const Grid::QCD::SpinColourMatrix &m, const SparseGamma &g)
+{
+    Grid::ComplexD tr = 0;
+    for(int t=0;t<4;t++)
+    {
+        Grid::ComplexD tc = 0;
+        for(int c=0;c<Grid::QCD::Nc;c++){ tc += m()(g.perm(t),t)(c,c); }
+        tr += times_i_pow(tc,g.coeff(t));
+    }
+    return tr;
+}
+
+// sum_k w_k tr( m * g_k ), e.g. tr( m * qslash ) with w = q. The colour traces are taken once
+// and shared, then each gamma is 4 phased picks
+Grid::ComplexD sparse_gamma_trace(const Grid::QCD::SpinColourMatrix &m, const std::vector<Grid::QCD::Gamma::Algebra> &g, const std::vector<double> &w)
+{
+    Grid::ComplexD tc[4][4];
+    for(int s=0;s<4;s++)
+    for(int t=0;t<4;t++)
+    {
+        tc[s][t] = 0;
+        for(int c=0;c<Grid::QCD::Nc;c++){ tc[s][t] += m()(s,t)(c,c); }
+    }
+
+    Grid::ComplexD tr = 0;
+    for(int k=0;k<g.size();k++)
+    {
+        SparseGamma gk(g[k]);
+        Grid::ComplexD trk = 0;
+        for(int t=0;t<4;t++){ trk += times_i_pow(tc[gk.perm(t)][t],gk.coeff(t)); }
+        tr += w[k]*trk;
+    }
+    return tr;
+}
+
+////////////////////////////////////
+//  compare the elements and the product table with Grid's dense gammas
+////////////////////////////////////
+bool sparse_gamma_equal(const Grid::QCD::SpinMatrix &a, const Grid::QCD::SpinMatrix &b)
+{
+    for(int s=0;s<4;s++)
+    for(int t=0;t<4;t++)
+    {
+        if(a()(s,t)() != b()(s,t)()){ return false; }
+    }
+    return true;
+}
+
+bool sparse_gamma_check()
+{
+    Grid::QCD::SpinMatrix rho;
+    rho = rho + Grid::Complex(1.0,0);
+
+    bool pass = true;
+    for(int a=0;a<Grid::QCD::Gamma::nGamma;a++)
+    {
+        if(!sparse_gamma_equal(SparseGamma(Grid::QCD::Gamma::Algebra(a)).dense(),rho*Grid::QCD::Gamma(Grid::QCD::Gamma::Algebra(a))))
+        {
+            std::cout << "Error: sparse gamma " << a << " differs from Grid's Gamma" << std::endl;
+            pass = false;
+        }
+    }
+    for(int i=0;i<SparseGammaTable::nGamma;i++)
+    for(int j=0;j<SparseGammaTable::nGamma;j++)
+    {
+        if(!sparse_gamma_equal((SparseGamma(i)*SparseGamma(j)).dense(),SparseGamma(i).dense()*SparseGamma(j).dense()))
+        {
+            std::cout << "Error: sparse gamma product " << i << "*" << j << " differs from the dense product" << std::endl;
+            pass = false;
+        }
+    }
+    return pass;
+}
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef TREE_CACHE_H
+#define TREE_CACHE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <Grid/Eigen/Core>
+
+////////////////////////////////////
+//  Cache of tree level projection matrices
+//
+//      The tree level of a momentum dependent scheme ( qslash ) depends on the momenta only
+//      through their directions and the ratio |p2|/|p1|, so the key is the scheme with
+//      p1/|p1| and p2/|p1| rounded to 10 digits. With a filename the cache is read on
+//      construction and each new entry appended, so runs over many kinematic points share it.
+//      File format, one entry per line:
+//          scheme nkin kin_1 .. kin_nkin rows cols value_11 value_12 .. (row major)
+////////////////////////////////////
+class TreeCache
+{
+    private:
+        std::string                             filename;
+        std::map<std::string,Eigen::MatrixXd>   trees;
+
+        static std::string  key(const std::string &scheme, const std::vector<double> &kinematics);
+
+    public:
+        TreeCache(std::string filename="");
+
+        static std::vector<double>  kinematics(std::vector<double> p1, std::vector<double> p2);
+        bool                        find(const std::string &scheme, std::vector<double> p1, std::vector<double> p2, Eigen::MatrixXd &tree);
+        void                        insert(const std::string &scheme, std::vector<double> p1, std::vector<double> p2, const Eigen::MatrixXd &tree);
+        size_t                      size(){ return trees.size(); }
+
+        // tree from the cache, calling compute() and storing the result if missing
+        template<class F>
+        Eigen::MatrixXd             get(const std::string &scheme, std::vector<double> p1, std::vector<double> p2, F compute);
+};
+
+std::vector<double> TreeCache::kinematics(std::vector<double> p1, std::vector<double> p2)
+{
+    double norm = 0;
+    for(auto p : p1){ norm += p*p; }
+    norm = std::sqrt(norm);
+
+    std::vector<double> kin;
+    for(auto p : p1){ kin.push_back(p/norm); }
+    for(auto p : p2){ kin.push_back(p/norm); }
+    return kin;
+}
+
+std::string TreeCache::key(const std::string &scheme, const std::vector<double> &kinematics)
+{
+    std::ostringstream ss;
+    ss << scheme << std::fixed << std::setprecision(10);
+    // + 0.0 so -0 and 0 give the same key
+    for(auto k : kinematics){ ss << " " << (std::round(k*1e10)/1e10 + 0.0); }
+    return ss.str();
+}
+
+TreeCache::TreeCache(std::string filename) : filename(filename)
+{
+    if(filename.empty()){ return; }
+    std::ifstream file(filename);
+    std::string line;
+    while(std::getline(file,line))
+    {
+        std::istringstream ss(line);
+        std::string scheme;
+        int nkin, rows, cols;
+        if(!(ss >> scheme >> nkin)){ continue; }
+        std::vector<double> kin(nkin);
+        for(auto &k : kin){ ss >> k; }
+        ss >> rows >> cols;
+        Eigen::MatrixXd tree(rows,cols);
+        for(int i=0;i<rows;i++)
+        for(int j=0;j<cols;j++)
+        {
+            ss >> tree(i,j);
+        }
+        if(ss.fail())
+        {
+            std::cout << "Warning: skipping unreadable line in tree cache " << filename << std::endl;
+            continue;
+        }
+        trees[key(scheme,kin)] = tree;
+    }
+}
+
+bool TreeCache::find(const std::string &scheme, std::vector<double> p1, std::vector<double> p2, Eigen::MatrixXd &tree)
+{
+    auto it = trees.find(key(scheme,kinematics(p1,p2)));
+    if(it == trees.end()){ return false; }
+    tree = it->second;
+    return true;
+}
+
+void TreeCache::insert(const std::string &scheme, std::vector<double> p1, std::vector<double> p2, const Eigen::MatrixXd &tree)
+{
+    std::vector<double> kin = kinematics(p1,p2);
+    trees[key(scheme,kin)] = tree;
+    if(filename.empty()){ return; }
+
+    std::ofstream file(filename,std::ios::app);
+    file << scheme << " " << kin.size() << std::setprecision(17);
+    for(auto k : kin){ file << " " << k; }
+    file << " " << tree.rows() << " " << tree.cols();
+    for(int i=0;i<tree.rows();i++)
+    for(int j=0;j<tree.cols();j++)
+    {
+        file << " " << tree(i,j);
+    }
+    file << std::endl;
+}
+
+template<class F>
+Eigen::MatrixXd TreeCache::get(const std::string &scheme, std::vector<double> p1, std::vector<double> p2, F compute)
+{
+    Eigen::MatrixXd tree;
+    if(find(scheme,p1,p2,tree)){ return tree; }
+    tree = compute();
+    insert(scheme,p1,p2,tree);
+    return tree;
+}
+
+#endif
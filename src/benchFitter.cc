@@ -0,0 +1,79 @@
+#include "AnalysisNPR.h"
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+#include <algorithm>
+
+///////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////
+//              Timing of the DistributionFitter backends on synthetic resampled data
+//
+//      gsl lmsder ( fitAll ), fixed size Levenberg-Marquardt ( fitAllFixed ) and the linear
+//      QR solve ( fitAllLinear ), each for every model in the fit function registry.
+//      Prints time per sample fit and the largest parameter difference from the QR solve.
+//
+//      Usage - benchFitter [nSamples] [nRepeats]
+///////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////
+
+template<class F>
+double time_per_fit(F fit, int nRepeats, int nSamples)
+{
+    auto start = std::chrono::steady_clock::now();
+    for(int r=0;r<nRepeats;r++){ fit(); }
+    std::chrono::duration<double,std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count()/(nRepeats*nSamples);
+}
+
+double max_difference(const std::vector<std::vector<double>> &a, const std::vector<std::vector<double>> &b)
+{
+    double diff = 0;
+    for(size_t i=0;i<a.size();i++)
+    for(size_t j=0;j<a[i].size();j++)
+    {
+        diff = std::max(diff,std::fabs(a[i][j]-b[i][j])/std::max(std::fabs(b[i][j]),1.0));
+    }
+    return diff;
+}
+
+int main(int argc, char *argv[])
+{
+    int nSamples    = (argc > 1) ? std::stoi(argv[1]) : 200;
+    int nRepeats    = (argc > 2) ? std::stoi(argv[2]) : 10;
+
+    // Z(p) ~ 0.7 + 0.02 p^2 + 0.05/p^2 over p = 1.5 .. 3 GeV, 1% jackknife spread
+    std::vector<double> p;
+    for(double pp=1.5; pp<3.01; pp+=0.25){ p.push_back(pp); }
+
+    std::mt19937                        rng(1234);
+    std::normal_distribution<double>    noise(0.0,0.01);
+    std::vector<std::vector<double>>    samples(nSamples,std::vector<double>(p.size()));
+    for(int i=0;i<nSamples;i++)
+    for(size_t k=0;k<p.size();k++)
+    {
+        samples[i][k] = 0.7 + 0.02*p[k]*p[k] + 0.05/(p[k]*p[k]) + noise(rng)/Grid::sqrt(nSamples);
+    }
+    Distribution<std::vector<double>> y(samples,"jackknife");
+
+    std::cout << nSamples << " samples, " << p.size() << " points, times in microseconds per sample fit" << std::endl;
+    std::cout << "model                  gsl     fixed    linear   |fixed-linear|  |gsl-linear|" << std::endl;
+    for(auto &model : fit_function_registry())
+    {
+        if(model.nParams >= (int)p.size()){ continue; }
+        DistributionFitter fit(y,p);
+        fit.assignFitFunction(model.f,model.df,model.func,std::vector<double>(model.nParams,1.0));
+
+        double t_linear = time_per_fit([&](){ fit.fitAllLinear(); },nRepeats,nSamples);
+        std::vector<std::vector<double>> linear = fit.get_params();
+        double t_gsl    = time_per_fit([&](){ fit.fitAll(); },nRepeats,nSamples);
+        std::vector<std::vector<double>> gsl    = fit.get_params();
+        double t_fixed  = time_per_fit([&](){ model.fit_fixed(fit); },nRepeats,nSamples);
+        std::vector<std::vector<double>> fixed  = fit.get_params();
+
+        std::printf("%-20s %8.2f %8.2f %8.2f %14.2e %13.2e\n",model.name.c_str(),t_gsl,t_fixed,t_linear,
+                    max_difference(fixed,linear),max_difference(gsl,linear));
+    }
+    return 0;
+}
@@ -45,6 +45,7 @@ int main(int argc, char *argv[])
     std::string prop2_file     = parseParam<std::string>(reader,"prop2_file");
     std::string vertex_file    = parseParam<std::string>(reader,"vertex_file");
     std::string output_dir     = parseParam<std::string>(reader,"output_dir");
+    bool amputate_vertices     = static_cast<bool>(parseParam<int>(reader,"amputate_vertices",0));
     ///////////////////////////////////////////////////////////////////////////////////////////
 
 
@@ -92,11 +93,6 @@ int main(int argc, char *argv[])
     std::cout << trace(Sin.get_values()).get_values() << " " << trace(Sout.get_values()).get_values() << std::endl;
 
 
-    //amputate the vertices
-    auto amp  = amputate(Sout,Sin,vf);
-
-    std::cout << trace(amp[0].get_values()).get_values() << std::endl;   
-
     /* 
     // set gamma indices for projection - S,P,V,A
     std::vector<Gamma::Algebra> I     = {Gamma::Algebra::Identity};
@@ -104,59 +100,57 @@ int main(int argc, char *argv[])
     std::vector<Gamma::Algebra> gmu   = {Gamma::Algebra::GammaT,Gamma::Algebra::GammaX,Gamma::Algebra::GammaY,Gamma::Algebra::GammaZ};
     std::vector<Gamma::Algebra> gmug5 = {Gamma::Algebra::GammaTGamma5,Gamma::Algebra::GammaXGamma5,Gamma::Algebra::GammaYGamma5,Gamma::Algebra::GammaZGamma5};
     */
-    // Gamma scheme projections
-    std::cout << "Projecting" << std::endl;
-    Distribution<Real> LambdaS = project_gamma(amp,I);
-    Distribution<Real> LambdaP = project_gamma(amp,g5);
-    Distribution<Real> LambdaV = project_gamma(amp,gmu);
-    Distribution<Real> LambdaA = -1*project_gamma(amp,gmug5);
-    Distribution<Real> LambdaT = -1*project_gamma(amp,sigma_mu_nu);
-    
-    // qslash scheme + projection
+    // qslash scheme momentum
     std::vector<double> q(4);
     for (int mu=0;mu<q.size();mu++){ q[mu] = 2*M_PI*(momentum[mu]+twist[mu])/latt_size[mu]; }
 
-    Distribution<Real> LambdaVq = project_qslash(amp,q,gmu);
-    Distribution<Real> LambdaAq = -1*project_qslash(amp,q,gmug5);
-
-    /////////////////// Also take Lambda A/S  - Lambda V/P //////////////////
-    save_result<std::vector<double>>(output_dir+"/LambdaSmPg.h5","LambdaSmPg",LambdaS.get_values()-LambdaP.get_values()); 
-    save_result<std::vector<double>>(output_dir+"/LambdaVmAg.h5","LambdaVmAg",LambdaV.get_values()-LambdaA.get_values()); 
-    save_result<std::vector<double>>(output_dir+"/LambdaVmAq.h5","LambdaVmAq",LambdaVq.get_values()-LambdaAq.get_values()); 
+    // the projections read the traces off the sparse gammas
+    if(!sparse_gamma_check())
+    {
+        std::cout << "Error: sparse gamma table does not match Grid's gamma convention" << std::endl;
+        return -1;
+    }
+    if(!qslash_projection_check(gmu) || !qslash_projection_check(gmug5)){ return -1; }
 
+    // Gamma and qslash scheme projections + Lambda S - Lambda P, Lambda V - Lambda A, in one pass over the samples
+    std::cout << "Projecting" << std::endl;
+    std::vector<BilinearChannel> channels = {
+        BilinearChannel("Sg",I),
+        BilinearChannel("Pg",g5),
+        BilinearChannel("Vg",gmu),
+        BilinearChannel("Ag",gmug5,-1),
+        BilinearChannel("Tg",sigma_mu_nu,-1),
+        BilinearChannel("Vq",gmu,1,true),
+        BilinearChannel("Aq",gmug5,-1,true),
+        BilinearChannel("SmPg",0,1),
+        BilinearChannel("VmAg",2,3),
+        BilinearChannel("VmAq",5,6)};
+    // by default the props are folded into the projectors and the amputated vertices never formed
+    std::vector<Distribution<Real>> Lambda;
+    if(amputate_vertices)
+    {
+        //amputate the vertices
+        auto amp  = amputate(Sout,Sin,vf);
+        std::cout << trace(amp[0].get_values()).get_values() << std::endl;   
+        Lambda    = project_bilinears(amp,q,channels);
+    }
+    else
+    {
+        Lambda    = project_bilinears(Sout,Sin,vf,q,channels);
+    }
+    if(Lambda.empty()){ return -1; }
 
     double qsq=0;
     for (int mu=0;mu<q.size();mu++){ qsq += pow(q[mu],2); }
       
     // Print out values + save to file   
     std::cout << "NPR for mom = " << momentum << "twist = " << twist << " q =  " << std::sqrt(qsq) << std::endl;
-    std::cout << "g S " << LambdaS.get_values() << std::endl;
-    std::cout << LambdaS.get_central() << " +/- " << LambdaS.get_std() << std::endl;
-    save_result<std::vector<double>>(output_dir+"/LambdaSg.h5","LambdaSg",LambdaS.get_values());
-    
-    std::cout << "g P " << LambdaP.get_values() << std::endl;
-    std::cout << LambdaP.get_central() << " +/- " << LambdaP.get_std() << std::endl;
-    save_result<std::vector<double>>(output_dir+"/LambdaPg.h5","LambdaPg",LambdaP.get_values());
-    
-    std::cout << "g V " << LambdaV.get_values() << std::endl;
-    std::cout << LambdaV.get_central() << " +/- " << LambdaV.get_std() << std::endl;
-    save_result<std::vector<double>>(output_dir+"/LambdaVg.h5","LambdaVg",LambdaV.get_values());
-    
-    std::cout << "g A " << LambdaA.get_values() << std::endl;
-    std::cout << LambdaA.get_central() << " +/- " << LambdaA.get_std() << std::endl;
-    save_result<std::vector<double>>(output_dir+"/LambdaAg.h5","LambdaAg",LambdaA.get_values());
-    
-    std::cout << "g T " << LambdaT.get_values() << std::endl;
-    std::cout << LambdaT.get_central() << " +/- " << LambdaT.get_std() << std::endl;
-    save_result<std::vector<double>>(output_dir+"/LambdaTg.h5","LambdaTg",LambdaT.get_values());
-    
-    std::cout << "q V " << LambdaVq.get_values() << std::endl;
-    std::cout << LambdaVq.get_central() << " +/- " << LambdaVq.get_std() << std::endl;
-    save_result<std::vector<double>>(output_dir+"/LambdaVq.h5","LambdaVq",LambdaVq.get_values());
-    
-    std::cout << "q A " << LambdaAq.get_values() << std::endl;
-    std::cout << LambdaAq.get_central() << " +/- " << LambdaAq.get_std() << std::endl;
-    save_result<std::vector<double>>(output_dir+"/LambdaAq.h5","LambdaAq",LambdaAq.get_values());
+    for(int k=0;k<channels.size();k++)
+    {
+        std::cout << channels[k].name << " " << Lambda[k].get_values() << std::endl;
+        std::cout << Lambda[k].get_central() << " +/- " << Lambda[k].get_std() << std::endl;
+        save_result<std::vector<double>>(output_dir+"/Lambda"+channels[k].name+".h5","Lambda"+channels[k].name,Lambda[k].get_values());
+    }
 
     return 0;
 }
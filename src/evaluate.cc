@@ -0,0 +1,140 @@
+#include <iostream>
+#include <string>
+#include <math.h>
+#include <sstream>
+#include <tuple>
+#include <utility>
+#include <algorithm>
+#include "Grid/Grid.h"
+#include "AnalysisNPR.h"
+#include "expression.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////
+//              Evaluates an expression of named results at every kinematic point
+//
+//      e.g. <expression>Lambda00/(LambdaA*LambdaA)</expression>
+//      The k-th name ( in order of first appearance ) is read from
+//      <input_dirs>[k]/<kinematic subdir>/<label>.h5 with <label> = input_labels[k], or the
+//      name itself without input_labels. The names are then free aliases, so the same label
+//      can come from two directories, e.g. a/b with input_labels Lambda00 Lambda00.
+//      input_dirs holds one directory per name or a single directory for all of them.
+//      Each ( dir, label ) is read once per kinematic point however often it is used.
+//      Without an expression the old divide inputs ( numName/den1Name/den2Name and their
+//      dirs ) give numName/(den1Name*den2Name).
+///////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char *argv[])
+{
+
+    //////////////////////// Read parameter info from xml //////////////////////////////////
+    std::string parameterFileName;
+
+    if (argc <= 1)
+    {
+        std::cout << "Usage - " << argv[0] << " <input xml filename>" << std::endl;
+        // write to template in case failure
+        std::vector<std::string> par_list = {"mass","momentum_list","twist_list","expression","input_dirs","input_labels","outputName","outputDir"};
+        Grid::XmlWriter writer("template.xml");
+        for ( auto par_name : par_list ){ write(writer,par_name,""); }
+
+        // exit with err
+        return -1;
+    }
+    else
+    {
+        parameterFileName=argv[1];
+    }
+
+    // set up xml reader
+    Grid::XmlReader reader(parameterFileName);
+
+    // Read data in label form
+    std::vector<std::string>    momentum_label    = parseParam<std::vector<std::string>>(reader,"momentum_list");
+    std::vector<std::string>    twist_label       = parseParam<std::vector<std::string>>(reader,"twist_list");
+    std::string                 mass_label        = parseParam<std::string>(reader,"mass");
+    std::string                 resampling        = parseParam<std::string>(reader,"resamplingType",std::string("none"));
+
+    // expression and where its inputs live
+    std::string                 expression_text   = parseParam<std::string>(reader,"expression",std::string());
+    std::vector<std::string>    input_dirs        = parseParam<std::vector<std::string>>(reader,"input_dirs",std::vector<std::string>());
+    std::vector<std::string>    input_labels      = parseParam<std::vector<std::string>>(reader,"input_labels",std::vector<std::string>());
+    if(expression_text.empty())
+    {
+        std::string numName     = parseParam<std::string>(reader,"numName");
+        std::string den1Name    = parseParam<std::string>(reader,"den1Name");
+        std::string den2Name    = parseParam<std::string>(reader,"den2Name");
+        std::string numDir      = parseParam<std::string>(reader,"numDir");
+        std::string den1Dir     = parseParam<std::string>(reader,"den1Dir");
+        std::string den2Dir     = parseParam<std::string>(reader,"den2Dir");
+        // one alias per input, the same name may come from different dirs
+        expression_text = "num/(den1*den2)";
+        input_dirs      = {numDir,den1Dir,den2Dir};
+        input_labels    = {numName,den1Name,den2Name};
+    }
+    // output
+    std::string outputName   =   parseParam<std::string>(reader,"outputName");
+    std::string outputDir    =   parseParam<std::string>(reader,"outputDir");
+
+    Expression                      expression(expression_text);
+    const std::vector<std::string> &names = expression.variables();
+    if(input_dirs.size() == 1){ input_dirs.resize(names.size(),input_dirs[0]); }
+    if(input_dirs.size() != names.size())
+    {
+        std::cout << "Error - " << names.size() << " inputs in " << expression_text << " but " << input_dirs.size() << " input_dirs" << std::endl;
+        return -1;
+    }
+    if(input_labels.empty()){ input_labels = names; }
+    if(input_labels.size() != names.size())
+    {
+        std::cout << "Error - " << names.size() << " inputs in " << expression_text << " but " << input_labels.size() << " input_labels" << std::endl;
+        return -1;
+    }
+    std::cout << outputName << " = " << expression_text << std::endl;
+    for(int k=0;k<names.size();k++){ std::cout << "    " << names[k] << " = " << input_dirs[k] << " : " << input_labels[k] << std::endl; }
+
+    // distinct ( dir, label ) pairs, source[k] the one feeding names[k]
+    std::vector<std::pair<std::string,std::string>> sources;
+    std::vector<int> source(names.size());
+    for(int k=0;k<names.size();k++)
+    {
+        std::pair<std::string,std::string> key(input_dirs[k],input_labels[k]);
+        auto it = std::find(sources.begin(),sources.end(),key);
+        if(it == sources.end()){ sources.push_back(key); it = sources.end()-1; }
+        source[k] = it-sources.begin();
+    }
+
+    //////////////////////// Read every input once per kinematic point ( hdf5 reads stay serial ) //////////////////////
+    int nKin = momentum_label.size();
+    std::vector<std::string> subdirs(nKin);
+    std::vector<std::vector<std::vector<double>>> inputs(nKin,std::vector<std::vector<double>>(names.size()));
+    for(int i=0;i<nKin;i++)
+    {
+        subdirs[i]  = "/Lambda_m"+(mass_label)+"_m"+(mass_label)+"_p0"+(momentum_label[i])+(momentum_label[i])+"0_p";
+        subdirs[i] += (momentum_label[i])+(momentum_label[i])+"00_tw"+(twist_label[i])+"/";
+        std::vector<std::vector<double>> read_values(sources.size());
+        for(int l=0;l<sources.size();l++)
+        {
+            Hdf5Reader  h5reader(sources[l].first+subdirs[i]+sources[l].second+".h5");
+            read(h5reader,sources[l].second,read_values[l]);
+        }
+        for(int k=0;k<names.size();k++){ inputs[i][k] = read_values[source[k]]; }
+    }
+
+    //////////////////////// Evaluate all kinematic points in parallel //////////////////////
+    std::vector<std::vector<double>> results(nKin);
+    parallel_for(int i=0;i<nKin;i++)
+    {
+        results[i] = expression.evaluate(inputs[i]);
+    }
+
+    for(int i=0;i<nKin;i++)
+    {
+        Distribution<double> result(results[i],resampling);
+        std::cout << subdirs[i] << " : " << result.get_central() << " +/- " << result.get_std() << std::endl;
+        save_result<std::vector<double>>(outputDir+subdirs[i]+outputName+".h5",outputName,results[i]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,239 @@
+#ifndef EXPRESSION_H
+#define EXPRESSION_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cctype>
+#include <cstdlib>
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////
+// Arithmetic expressions over named distributions, e.g. Lambda00/(LambdaA*LambdaA)
+//
+//      + - * / ^, unary -, parentheses, numbers, names, sqrt() log() exp() abs()
+//
+// Parsed once into a postfix program. Each name appears once in variables() however often
+// it is used; a name is only an alias, the caller binds it to its input. evaluate() runs the whole program over a block
+// of samples at a time: every instruction is a simple loop over the block, which the
+// compiler vectorises, and the intermediates stay in cache, so the inputs are passed over
+// once for the whole expression.
+////////////////////////////////////////////////////////////////////////
+class Expression
+{
+    private:
+        enum class Op { constant, variable, add, sub, mul, div, pow, neg, sqrt, log, exp, abs };
+        struct Instruction
+        {
+            Op      op;
+            int     index;
+            double  value;
+        };
+
+        std::string                 text;
+        size_t                      pos;
+        std::vector<Instruction>    program;
+        std::vector<std::string>    names;
+        int                         depth, maxDepth;
+
+        static const int            block = 256;
+
+        void    error(const std::string &message);
+        void    skip(){ while(pos < text.size() && std::isspace(text[pos])){ pos++; } }
+        bool    accept(char c);
+        void    emit(Op op, int index=0, double value=0);
+
+        // recursive descent, lowest precedence first
+        void    sum();
+        void    product();
+        void    unary();
+        void    power();
+        void    primary();
+
+    public:
+        Expression(const std::string &text);
+
+        // distinct names, in order of first appearance
+        const std::vector<std::string> &    variables() const { return names; }
+        // values[k] the samples of variables()[k], all the same length
+        std::vector<double>                 evaluate(const std::vector<std::vector<double>> &values) const;
+};
+
+Expression::Expression(const std::string &text) : text(text), pos(0), depth(0), maxDepth(0)
+{
+    sum();
+    skip();
+    if(pos != text.size()){ error("unexpected character"); }
+}
+
+void Expression::error(const std::string &message)
+{
+    std::cout << "Error - " << message << " in expression \"" << text << "\" at position " << pos << std::endl;
+    exit(1);
+}
+
+bool Expression::accept(char c)
+{
+    skip();
+    if(pos < text.size() && text[pos] == c)
+    {
+        pos++;
+        return true;
+    }
+    return false;
+}
+
+void Expression::emit(Op op, int index, double value)
+{
+    program.push_back({op,index,value});
+    // leaves push, binary ops pop one, unary ops leave the depth unchanged
+    if(op == Op::constant || op == Op::variable)                                    { depth++; }
+    else if(op == Op::add || op == Op::sub || op == Op::mul || op == Op::div || op == Op::pow) { depth--; }
+    maxDepth = std::max(maxDepth,depth);
+}
+
+void Expression::sum()
+{
+    product();
+    while(true)
+    {
+        if(accept('+'))     { product(); emit(Op::add); }
+        else if(accept('-')){ product(); emit(Op::sub); }
+        else                { return; }
+    }
+}
+
+void Expression::product()
+{
+    unary();
+    while(true)
+    {
+        if(accept('*'))     { unary(); emit(Op::mul); }
+        else if(accept('/')){ unary(); emit(Op::div); }
+        else                { return; }
+    }
+}
+
+void Expression::unary()
+{
+    if(accept('-')){ unary(); emit(Op::neg); }
+    else if(accept('+')){ unary(); }
+    else{ power(); }
+}
+
+void Expression::power()
+{
+    primary();
+    // right associative, binds tighter than unary minus on its left: -a^2 = -(a^2)
+    if(accept('^')){ unary(); emit(Op::pow); }
+}
+
+void Expression::primary()
+{
+    skip();
+    if(accept('('))
+    {
+        sum();
+        if(!accept(')')){ error("missing )"); }
+        return;
+    }
+    if(pos < text.size() && (std::isdigit(text[pos]) || text[pos] == '.'))
+    {
+        const char *start = text.c_str()+pos;
+        char *end;
+        double value = std::strtod(start,&end);
+        pos += end-start;
+        emit(Op::constant,0,value);
+        return;
+    }
+    if(pos < text.size() && (std::isalpha(text[pos]) || text[pos] == '_'))
+    {
+        size_t start = pos;
+        while(pos < text.size() && (std::isalnum(text[pos]) || text[pos] == '_')){ pos++; }
+        std::string name = text.substr(start,pos-start);
+
+        if(accept('('))
+        {
+            Op op;
+            if      (name == "sqrt"){ op = Op::sqrt; }
+            else if (name == "log") { op = Op::log; }
+            else if (name == "exp") { op = Op::exp; }
+            else if (name == "abs") { op = Op::abs; }
+            else                    { error("unknown function "+name); }
+            sum();
+            if(!accept(')')){ error("missing )"); }
+            emit(op);
+            return;
+        }
+
+        auto it = std::find(names.begin(),names.end(),name);
+        if(it == names.end()){ names.push_back(name); it = names.end()-1; }
+        emit(Op::variable,it-names.begin());
+        return;
+    }
+    error("expected a number, name or (");
+}
+
+std::vector<double> Expression::evaluate(const std::vector<std::vector<double>> &values) const
+{
+    if(values.size() != names.size())
+    {
+        std::cout << "Error - expression \"" << text << "\" needs " << names.size() << " inputs, given " << values.size() << std::endl;
+        exit(1);
+    }
+    size_t n = (values.empty()) ? 1 : values[0].size();
+    for(auto &v : values)
+    {
+        if(v.size() != n)
+        {
+            std::cout << "Error - inputs of expression \"" << text << "\" have different numbers of samples" << std::endl;
+            exit(1);
+        }
+    }
+
+    std::vector<double> result(n);
+    std::vector<double> stack(maxDepth*block);
+    for(size_t start=0; start<n; start+=block)
+    {
+        int len = std::min<size_t>(block,n-start);
+        int top = 0;    // next free slot
+        for(auto &ins : program)
+        {
+            double *a = (top > 1) ? &stack[(top-2)*block] : nullptr;   // second from top, for binary ops
+            double *b = (top > 0) ? &stack[(top-1)*block] : nullptr;   // top
+            switch(ins.op)
+            {
+                case Op::constant:
+                {
+                    double *s = &stack[top*block];
+                    for(int j=0;j<len;j++){ s[j] = ins.value; }
+                    top++;
+                    break;
+                }
+                case Op::variable:
+                {
+                    double *s = &stack[top*block];
+                    const double *v = &values[ins.index][start];
+                    for(int j=0;j<len;j++){ s[j] = v[j]; }
+                    top++;
+                    break;
+                }
+                case Op::add:  for(int j=0;j<len;j++){ a[j] += b[j]; }               top--; break;
+                case Op::sub:  for(int j=0;j<len;j++){ a[j] -= b[j]; }               top--; break;
+                case Op::mul:  for(int j=0;j<len;j++){ a[j] *= b[j]; }               top--; break;
+                case Op::div:  for(int j=0;j<len;j++){ a[j] /= b[j]; }               top--; break;
+                case Op::pow:  for(int j=0;j<len;j++){ a[j] = std::pow(a[j],b[j]); } top--; break;
+                case Op::neg:  for(int j=0;j<len;j++){ b[j] = -b[j]; }               break;
+                case Op::sqrt: for(int j=0;j<len;j++){ b[j] = std::sqrt(b[j]); }     break;
+                case Op::log:  for(int j=0;j<len;j++){ b[j] = std::log(b[j]); }      break;
+                case Op::exp:  for(int j=0;j<len;j++){ b[j] = std::exp(b[j]); }      break;
+                case Op::abs:  for(int j=0;j<len;j++){ b[j] = std::fabs(b[j]); }     break;
+            }
+        }
+        std::copy(stack.begin(),stack.begin()+len,result.begin()+start);
+    }
+    return result;
+}
+
+#endif
@@ -50,7 +50,7 @@ int main(int argc, char *argv[])
     double                      ainv            =   parseParam<double>(reader,"ainv");  
     std::string                 dirName         =   parseParam<std::string>(reader,"data_directory");
     std::string                 fileName        =   parseParam<std::string>(reader,"file_name");
-    std::string                 vertex          =   parseParam<std::string>(reader,"vertex");
+    std::string                 vertex          =   parseParam<std::string>(reader,"vertex",std::string()); // or vertex_list
     std::string                 resampling      =   parseParam<std::string>(reader,"resamplingType");
 
     // Read data in numerical form
@@ -68,8 +68,45 @@ int main(int argc, char *argv[])
     std::vector<double>         p_extrap        =   parseParam<std::vector<double>>(reader,"p_extrap");
     std::string                 output_dir      =   parseParam<std::string>(reader,"output_dir");                
     std::vector<double>         p_range         =   parseParam<std::vector<double>>(reader,"p_range");
+    // 0 linear least squares, 1 gsl Levenberg-Marquardt, 2 fixed size Levenberg-Marquardt
+    int                         nonlinear_fit   =   parseParam<int>(reader,"nonlinear_fit",0);
+    bool                        correlated      =   static_cast<bool>(parseParam<int>(reader,"correlated",0));
+    double                      shrinkage       =   parseParam<double>(reader,"shrinkage",0.0);
+    int                         n_plot          =   parseParam<int>(reader,"n_plot",1001);
+    double                      band_cl         =   parseParam<double>(reader,"band_cl",0.68);
+    // scan all momentum windows and fit functions instead of fitting p_range with fitfunction
+    bool                        scan            =   static_cast<bool>(parseParam<int>(reader,"scan",0));
+    // batch mode: fit every vertex in the list ( same momenta ) with one solve, vertex_list[v]
+    // read from <vertex_files[v]>.h5, by default <vertex_list[v]>.h5 as the analyses write them
+    std::vector<std::string>    vertex_list     =   parseParam<std::vector<std::string>>(reader,"vertex_list",std::vector<std::string>());
+    std::vector<std::string>    vertex_files    =   parseParam<std::vector<std::string>>(reader,"vertex_files",std::vector<std::string>());
     ///////////////////////////////////////////////////////////////////////////////////
 
+    if(vertex_files.empty()){ vertex_files = vertex_list; }
+    if(vertex_files.size() != vertex_list.size())
+    {
+        std::cout << "Error: " << vertex_list.size() << " entries in vertex_list but " << vertex_files.size() << " vertex_files" << std::endl;
+        return -1;
+    }
+
+    if(shrinkage < 0 || shrinkage > 1)
+    {
+        std::cout << "Error: shrinkage must be between 0 and 1" << std::endl;
+        return -1;
+    }
+    if(n_plot < 2)
+    {
+        std::cout << "Error: n_plot must be at least 2" << std::endl;
+        return -1;
+    }
+
+    // batch mode only does the uncorrelated linear fit over p_range
+    if(!vertex_list.empty() && (nonlinear_fit != 0 || correlated || shrinkage != 0 || scan))
+    {
+        std::cout << "Error: vertex_list does not support nonlinear_fit, correlated, shrinkage or scan" << std::endl;
+        return -1;
+    }
+
     ///////////////////////////////////////////////////////////////////////////////////////////
     //  Set up text file for writing
     ///////////////////////////////////////////////////////////////////////////////////////////
@@ -84,6 +121,8 @@ int main(int argc, char *argv[])
     std::string                             inputFileName;
     std::vector<double>                     p;
     std::vector<std::vector<double>>        y_vector;
+    // batch mode, [vertex][momentum][sample]
+    std::vector<std::vector<std::vector<double>>>   batch_vector(vertex_list.size());
 
     outputTextFile << "data" << std::endl;
     for(int i=0;i<momentum.size();i++)
@@ -93,29 +132,153 @@ int main(int argc, char *argv[])
         inputFileName+="_p0"+(momentum_label[i])+(momentum_label[i])+"0_p";
         inputFileName+=(momentum_label[i])+(momentum_label[i])+"00_tw"+(twist_label[i]);
         
+        //////////////////////////momentum ///////////////////////
+        double p_i = (Grid::sqrt(2)*2.0*M_PI/(static_cast<double>(latt_size[0])))*(static_cast<double>(momentum[i]) + twist[i])*ainv;
+        bool in_range = scan || (p_i > p_range[0] && p_i < p_range[1]);
+
+        /////////////////// batch: every vertex, one reader per file /////////////////////
+        if(!vertex_list.empty())
+        {
+            std::vector<std::vector<double>>    data_tmp(vertex_list.size());
+            std::vector<bool>                   done(vertex_list.size(),false);
+            for(int v=0;v<vertex_list.size();v++)
+            {
+                if(done[v]){ continue; }
+                Hdf5Reader h5reader(inputFileName+"/"+vertex_files[v]+".h5");
+                for(int w=v;w<vertex_list.size();w++)
+                {
+                    if(vertex_files[w] != vertex_files[v]){ continue; }
+                    read(h5reader,vertex_list[w],data_tmp[w]);
+                    done[w] = true;
+                }
+            }
+            for(int v=0;v<vertex_list.size();v++)
+            {
+                Distribution<double> dist(data_tmp[v],resampling);
+                outputTextFile << vertex_list[v] << "\t" << p_i << "\t" << dist.get_central() << "\t" << dist.get_std() << std::endl;
+                if(in_range){ batch_vector[v].push_back(data_tmp[v]); }
+            }
+            if(in_range){ p.push_back(p_i); }
+            continue;
+        }
+
         /////////////////// read vertex /////////////////////
         Hdf5Reader                          h5reader(inputFileName+"/"+fileName+".h5");
         std::vector<double>                 data_tmp;
         read(h5reader,vertex,data_tmp);
         Distribution<double>                dist(data_tmp,resampling);
 
-        //////////////////////////momentum ///////////////////////
-        double p_i = (Grid::sqrt(2)*2.0*M_PI/(static_cast<double>(latt_size[0])))*(static_cast<double>(momentum[i]) + twist[i])*ainv;
-        
         //////////////////////// write to text file //////////////////
         outputTextFile << p_i << "\t" << dist.get_central() << "\t" << dist.get_std() << std::endl;
 
         ////////////////// Add to data if within range ////////////////
-        if( p_i > p_range[0] && p_i < p_range[1] )
+        if(in_range)
         {
             p.push_back(p_i);
             y_vector.push_back(dist.get_values());
         }
     }
 
+    ///////////////////////////////////////////////////////////////////////////////////////////
+    // Batch: all vertices share the momenta and so the design matrix, one QR for every
+    // vertex and sample ( the columns of Y ), all results to one file
+    ///////////////////////////////////////////////////////////////////////////////////////////
+    if(!vertex_list.empty())
+    {
+        FitFunction model;
+        if(!find_fit_function(fitfunction,model))
+        {
+            std::cout << "Error: fit function must be one of: " << fit_function_names() << std::endl;
+            return -1;
+        }
+        if(p.size() <= model.nParams)
+        {
+            std::cout << "Error: " << p.size() << " momenta in p_range leave no degrees of freedom for " << model.nParams << " parameters" << std::endl;
+            return -1;
+        }
+        int dof         = p.size()-model.nParams;
+        int nVertices   = vertex_list.size();
+        int nSamples    = batch_vector[0][0].size();
+        Eigen::MatrixXd Y(p.size(),nVertices*nSamples);
+        for(int v=0;v<nVertices;v++)
+        for(int i=0;i<p.size();i++)
+        for(int s=0;s<nSamples;s++)
+        {
+            Y(i,v*nSamples+s) = batch_vector[v][i][s];
+        }
+
+        LinearFitter    linfit(model.df,p,model.nParams,std::vector<double>(p.size(),1.0));
+        Eigen::MatrixXd batch_params    = linfit.solve(Y);
+        Eigen::VectorXd batch_chi       = linfit.residual_norm(Y,batch_params);
+        Eigen::MatrixXd batch_extrap    = linear_basis(model.df,p_extrap,model.nParams)*batch_params;
+
+        std::vector<std::vector<std::string>>           labels(nVertices);
+        std::vector<std::vector<std::vector<double>>>   results(nVertices);
+        outputTextFile << "extrapolated" << std::endl;
+        for(int v=0;v<nVertices;v++)
+        {
+            std::vector<double> chisq_dof_values(nSamples);
+            for(int s=0;s<nSamples;s++){ chisq_dof_values[s] = batch_chi(v*nSamples+s)*batch_chi(v*nSamples+s)/dof; }
+            std::cout << vertex_list[v] << " : Chi^2 / d.o.f. = " << Distribution<double>(chisq_dof_values,resampling).get_central() << std::endl;
+            for(int i=0;i<p_extrap.size();i++)
+            {
+                std::vector<double> values(nSamples);
+                for(int s=0;s<nSamples;s++){ values[s] = batch_extrap(i,v*nSamples+s); }
+                Distribution<double>    f_extrap(values,resampling);
+                outputTextFile  << vertex_list[v] << "\t" << p_extrap[i] << "\t" << f_extrap.get_central() << "\t" << f_extrap.get_std() << std::endl;
+                std::cout       << vertex_list[v] << " at " << p_extrap[i] << "GeV : " << f_extrap.get_central() << " +/- " << f_extrap.get_std() << std::endl;
+                labels[v].push_back(vertex_list[v]+"_p"+std::to_string(p_extrap[i]).substr(0,3)+"GeV");
+                results[v].push_back(values);
+            }
+        }
+        save_result<std::vector<double>>(output_dir+"/"+fileName+"_batch.h5",labels,results);
+        return 0;
+    }
+
     ////////////////////// Convert vector(n_p, n_samples) to Distribution<vector(n_p)>(n_samples) //////////////
     y_vector = transpose(y_vector);
     Distribution<std::vector<double>> y(y_vector,resampling);
+
+    ///////////////////////////////////////////////////////////////////////////////////////////
+    // Scan: every window and model in one run, ranked by AIC and averaged
+    ///////////////////////////////////////////////////////////////////////////////////////////
+    if(scan)
+    {
+        FitScan                             scanner(y,p);
+        if(!scanner.check()){ return -1; }
+        std::vector<ScanResult>             results = scanner.run(p_extrap);
+        if(results.empty() || results[0].weight == 0)
+        {
+            std::cout << "Error: no momentum window has enough points for a non degenerate fit" << std::endl;
+            return -1;
+        }
+        std::vector<double>                 sys;
+        std::vector<std::vector<double>>    averaged = scanner.average(results,sys);
+
+        outputTextFile << "scan" << std::endl;
+        outputTextFile << "model\tp_min\tp_max\tn\tchi2/dof\tAIC\tweight";
+        for(auto pe : p_extrap){ outputTextFile << "\tf(" << pe << ")"; }
+        outputTextFile << std::endl;
+        for(auto &r : results)
+        {
+            outputTextFile << r.model << "\t" << r.p_min << "\t" << r.p_max << "\t" << r.nPoints << "\t"
+                           << r.chisq/(r.nPoints-r.nParams) << "\t" << r.aic << "\t" << r.weight;
+            for(auto &e : r.extrap){ outputTextFile << "\t" << Distribution<double>(e,resampling).get_central(); }
+            outputTextFile << std::endl;
+        }
+
+        std::cout << results.size() << " fits, best " << results[0].model << " over " << results[0].p_min << " - " << results[0].p_max
+                  << " GeV with weight " << results[0].weight << std::endl;
+        outputTextFile << "averaged" << std::endl;
+        for(int i=0;i<p_extrap.size();i++)
+        {
+            Distribution<double>    f_extrap(averaged[i],resampling);
+            outputTextFile  << p_extrap[i] << "\t" << f_extrap.get_central() << "\t" << f_extrap.get_std() << "\t" << sys[i] << std::endl;
+            std::cout       << "model average at " << p_extrap[i] << "GeV : " << f_extrap.get_central() << " +/- " << f_extrap.get_std() << " (stat) +/- " << sys[i] << " (sys)" << std::endl;
+            save_result<std::vector<double>>(output_dir+"/"+fileName+"_scan_p"+std::to_string(p_extrap[i]).substr(0,3)+"GeV.h5",vertex,f_extrap.get_values());
+        }
+        return 0;
+    }
     
     ///////////////////////////////////////////////////////////////////////////////////////////
     // Fitting
@@ -125,30 +288,35 @@ int main(int argc, char *argv[])
     DistributionFitter fit(y,p);
     
 
-    // better way of doing this??? hard to read
-    // ////////////////////////// Assign fit function and initial param guess //////////////////////
-    if(fitfunction == "inv_p2"){            fit.assignFitFunction(psq_inv_f, psq_inv_df, psq_inv, std::vector<double>(2,1.0)); }
-    else if(fitfunction == "inv_p6"){       fit.assignFitFunction(psix_inv_f, psix_inv_df, psix_inv,std::vector<double>(2,1.0));}
-    else if(fitfunction == "inv_p2_inv_p6"){fit.assignFitFunction(psq_psix_inv_f, psq_psix_inv_df, psq_psix_inv,std::vector<double>(3,1.0));}
-    else if(fitfunction == "p2_inv_p2"){fit.assignFitFunction(psq_psq_inv_f, psq_psq_inv_df, psq_psq_inv,std::vector<double>(3,1.0));}
-    else if(fitfunction == "p2"){           fit.assignFitFunction(psq_f,psq_df,psq,std::vector<double>(2,1.0));}
-    else if(fitfunction == "p6"){           fit.assignFitFunction(psix_f,psix_df,psix,std::vector<double>(2,1.0));}
-    else if(fitfunction == "p2_p6"){        fit.assignFitFunction(psq_psix_f,psq_psix_df,psq_psix,std::vector<double>(3,1.0));}
-    else if(fitfunction == "polysq"){        fit.assignFitFunction(polysq_f,polysq_df,polysq,std::vector<double>(4,1.0));}
-    else if(fitfunction == "inv_polysq"){        fit.assignFitFunction(inv_polysq_f,inv_polysq_df,inv_polysq,std::vector<double>(4,1.0));}
-    else
+    ////////////////////////// Assign fit function from the registry, initial params all 1 //////////////////////
+    FitFunction model;
+    if(!find_fit_function(fitfunction,model))
     {
-        std::cout << "Error: fit function must be one of: inv_p6, inv_p2, inv_p2_inv_p6, p2, p6, p2_p6, polysq, inv_polysq" << std::endl;
+        std::cout << "Error: fit function must be one of: " << fit_function_names() << std::endl;
         return -1;
     }
+    if(p.size() <= model.nParams)
+    {
+        std::cout << "Error: " << p.size() << " momenta in p_range leave no degrees of freedom for " << model.nParams << " parameters" << std::endl;
+        return -1;
+    }
+    int dof = p.size()-model.nParams;
+    fit.assignFitFunction(model.f,model.df,model.func,std::vector<double>(model.nParams,1.0));
 
     //////////////////// Run Fit and get params and chi^2 ////////////////////
-    fit.fitAll();
+    if(correlated){ fit.setCorrelated(shrinkage); }
+    // all the models are linear in their parameters: one factorisation for every sample
+    if      (nonlinear_fit == 1){ fit.fitAll(); }
+    else if (nonlinear_fit == 2){ model.fit_fixed(fit); }
+    else                        { fit.fitAllLinear(); }
     Distribution<std::vector<double>>    params  = Distribution<std::vector<double>>(fit.get_params(),resampling);
     Distribution<double>                 chi     = Distribution<double>(fit.get_chi(),resampling);
+    std::vector<double>                  chisq_dof_values;
+    for(auto c : fit.get_chi()){ chisq_dof_values.push_back(c*c/dof); }
+    Distribution<double>                 chisq_dof(chisq_dof_values,resampling);
     
     ////////////////////// Print fit results /////////////////////////
-    std::cout << "Chi^2 / d.o.f. = " <<  chi.get_central() << " +/- " << chi.get_std() << std::endl;
+    std::cout << "Chi^2 / d.o.f. = " <<  chisq_dof.get_central() << " +/- " << chisq_dof.get_std() << std::endl;
     std::cout << "The parameters are : " << std::endl;
     for ( int i=0; i<params.get_central().size(); i++)
     {
@@ -157,9 +325,10 @@ int main(int argc, char *argv[])
 
     //////////////////// Caclulate and write extrapolated values ///////////////////
     outputTextFile << "extrapolated" << std::endl;
+    std::vector<std::vector<double>> f_extrap_values = fit.extrapolate(p_extrap);
     for(int i=0;i<p_extrap.size();i++)
     { 
-        Distribution<double>    f_extrap(fit.extrapolate(p_extrap[i]),resampling);
+        Distribution<double>    f_extrap(f_extrap_values[i],resampling);
         
         outputTextFile  << p_extrap[i] << "\t" << f_extrap.get_central() << "\t" << f_extrap.get_std() << std::endl; 
         std::cout       << "value at " << p_extrap[i]   << "GeV : " << f_extrap.get_central() << " +/- " << f_extrap.get_std() << std::endl; 
@@ -171,7 +340,6 @@ int main(int argc, char *argv[])
     ///////////////////////////////////////////////////////////////////////////////////////////
     // Calculate fitted values in range and write for plotting
     ///////////////////////////////////////////////////////////////////////////////////////////
-    outputTextFile << "fit" << std::endl;
     
     ////////////////////// Find min(max) momentum from given extrap range and data ////////////////////
     std::vector<double>::iterator pmin_ptr = std::min_element(p.begin(), p.end());
@@ -182,15 +350,15 @@ int main(int argc, char *argv[])
     p_min = (p_min < p_range[0]) ? p_min : p_range[0];
     p_max = (p_max > p_range[1]) ? p_max: p_range[1];
     
-    ////////////////////// Calculate f(p) and write ///////////////////////////
-    double p_plot;
-    Distribution<double>    f_plot;
-    for(int i=0; i<1001; i++)
-    {
-        p_plot = static_cast<float>(i)/1000*(p_max-p_min)+p_min;
-        f_plot = Distribution<double>(fit.extrapolate(p_plot),resampling);
-        outputTextFile << p_plot << "\t" << f_plot.get_central() << "\t" << f_plot.get_std() << std::endl;
-    }
+    ////////////////////// Calculate f(p) with its error band for all samples at once and write columns to h5 ///////////////////////////
+    std::vector<double> p_plot(n_plot);
+    for(int i=0; i<n_plot; i++){ p_plot[i] = static_cast<double>(i)/(n_plot-1)*(p_max-p_min)+p_min; }
+    ErrorBand band = fit.errorBand(p_plot,band_cl);
+    save_result<std::vector<double>>(output_dir+"/"+fileName+"_band.h5",
+                                     {"p","central","std","lower","upper"},
+                                     {band.x,band.central,band.std,band.lower,band.upper});
+    outputTextFile << "fit" << std::endl;
+    outputTextFile << "band written to " << fileName << "_band.h5" << std::endl;
 
 
     
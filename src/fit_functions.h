@@ -5,615 +5,164 @@
 #include <gsl/gsl_vector.h>
 #include "AnalysisNPR.h"
 #include <iostream>
+#include <string>
 #include <vector>
 
 
-/////////////////////////// A + B/p^2 /////////////////////////////
-int psq_inv_f(const gsl_vector *p, void *data, gsl_vector *f)
-{
-    //unpack data from struct
-    size_t n    =   ((struct DataSet*)data)->n;
-    std::vector<double> x   =   ((struct DataSet*)data)->x;
-    std::vector<double> y   =   ((struct DataSet*)data)->y;
-
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-
-    //calculate model value and put residual into gsl vector
-    for ( size_t i=0; i < n; i++)
-    {
-        double Yi = p0 + p1/(x[i]*x[i]);
-        gsl_vector_set (f, i, Yi - y[i]);
-    }
-    return GSL_SUCCESS;
-}
-
-//derivative
-int psq_inv_df(const gsl_vector *p, void *data, gsl_matrix *J)
-{
-    //unpack data from struct
-    size_t n    =   ((struct DataSet*)data)->n;
-    std::vector<double> x   =   ((struct DataSet*)data)->x;
-    std::vector<double> y   =   ((struct DataSet*)data)->y;
-
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-
-    //Jacobian matrix J(i,j) = dfi / dpj
-    // fi = (Yi - yi)/sigma[i]
-    for ( size_t i=0; i<n; i++ )
-    {
-        gsl_matrix_set(J,i,0,1.0);
-        gsl_matrix_set(J,i,1,1.0/(x[i]*x[i]));
-    }
-    return GSL_SUCCESS;
-}
-//plain function
-double psq_inv(const gsl_vector *p, double x0)
-{
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-
-    return p0 + p1/pow(x0,2);
-}
-
-/////////////////////////// A + B/p^6 /////////////////////////////
-int psix_inv_f(const gsl_vector *p, void *data, gsl_vector *f)
-{
-    //unpack data from struct
-    size_t n    =   ((struct DataSet*)data)->n;
-    std::vector<double> x   =   ((struct DataSet*)data)->x;
-    std::vector<double> y   =   ((struct DataSet*)data)->y;
-
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-
-    //calculate model value and put residual into gsl vector
-    for ( size_t i=0; i < n; i++)
-    {
-        double Yi = p0 + p1/(pow(x[i],6));
-        gsl_vector_set (f, i, Yi - y[i]);
-    }
-    return GSL_SUCCESS;
-}
-
-//derivative
-int psix_inv_df(const gsl_vector *p, void *data, gsl_matrix *J)
-{
-    //unpack data from struct
-    size_t n    =   ((struct DataSet*)data)->n;
-    std::vector<double> x   =   ((struct DataSet*)data)->x;
-    std::vector<double> y   =   ((struct DataSet*)data)->y;
-
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-
-    //Jacobian matrix J(i,j) = dfi / dpj
-    // fi = (Yi - yi)/sigma[i]
-    for ( size_t i=0; i<n; i++ )
-    {
-        gsl_matrix_set(J,i,0,1.0);
-        gsl_matrix_set(J,i,1,1.0/pow(x[i],6));
-    }
-    return GSL_SUCCESS;
-}
-//plain function
-double psix_inv(const gsl_vector *p, double x0)
-{
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-
-    return p0 + p1/pow(x0,6);
-}
-
-/////////////////////////// A + +B/p^2 + C/p^6 /////////////////////////////
-int psq_psix_inv_f(const gsl_vector *p, void *data, gsl_vector *f)
-{
-    //unpack data from struct
-    size_t n    =   ((struct DataSet*)data)->n;
-    std::vector<double> x   =   ((struct DataSet*)data)->x;
-    std::vector<double> y   =   ((struct DataSet*)data)->y;
-
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-    double p2 = gsl_vector_get(p,2);
-
-    //calculate model value and put residual into gsl vector
-    for ( size_t i=0; i < n; i++)
-    {
-        double Yi = p0 + p1/pow(x[i],2) + p2/pow(x[i],6);
-        gsl_vector_set (f, i, Yi - y[i]);
-    }
-    return GSL_SUCCESS;
-}
-
-//derivative
-int psq_psix_inv_df(const gsl_vector *p, void *data, gsl_matrix *J)
-{
-    //unpack data from struct
-    size_t n    =   ((struct DataSet*)data)->n;
-    std::vector<double> x   =   ((struct DataSet*)data)->x;
-    std::vector<double> y   =   ((struct DataSet*)data)->y;
-
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-    double p2 = gsl_vector_get(p,2);
-
-    //Jacobian matrix J(i,j) = dfi / dpj
-    // fi = (Yi - yi)/sigma[i]
-    for ( size_t i=0; i<n; i++ )
-    {
-        gsl_matrix_set(J,i,0,1.0);
-        gsl_matrix_set(J,i,1,1.0/pow(x[i],2));
-        gsl_matrix_set(J,i,2,1.0/pow(x[i],6));
-    }
-    return GSL_SUCCESS;
-}
-
-//plain function
-double psq_psix_inv(const gsl_vector *p, double x0)
-{
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-    double p2 = gsl_vector_get(p,2);
-
-    return p0 + p1/pow(x0,2) + p2/pow(x0,6);
-}
-
-
-/*************************** A + B*p^2 *****************************/
-int psq_f(const gsl_vector *p, void *data, gsl_vector *f)
-{
-    //unpack data from struct
-    size_t n    =   ((struct DataSet*)data)->n;
-    std::vector<double> x   =   ((struct DataSet*)data)->x;
-    std::vector<double> y   =   ((struct DataSet*)data)->y;
-
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-
-    //calculate model value and put residual into gsl vector
-    for ( size_t i=0; i < n; i++)
-    {
-        double Yi = p0 + p1*(x[i]*x[i]);
-        gsl_vector_set (f, i, Yi - y[i]);
-    }
-    return GSL_SUCCESS;
-}
-
-//derivative
-int psq_df(const gsl_vector *p, void *data, gsl_matrix *J)
-{
-    //unpack data from struct
-    size_t n    =   ((struct DataSet*)data)->n;
-    std::vector<double> x   =   ((struct DataSet*)data)->x;
-    std::vector<double> y   =   ((struct DataSet*)data)->y;
-
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-
-    //Jacobian matrix J(i,j) = dfi * dpj
-    // fi = (Yi - yi)*sigma[i]
-    for ( size_t i=0; i<n; i++ )
-    {
-        gsl_matrix_set(J,i,0,1.0);
-        gsl_matrix_set(J,i,1,1.0*(x[i]*x[i]));
-    }
-    return GSL_SUCCESS;
-}
-//plain function
-double psq(const gsl_vector *p, double x0)
-{
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-
-    return p0 + p1*pow(x0,2);
-}
-
-/*************************** A + B*p^6 *****************************/
-int psix_f(const gsl_vector *p, void *data, gsl_vector *f)
-{
-    //unpack data from struct
-    size_t n    =   ((struct DataSet*)data)->n;
-    std::vector<double> x   =   ((struct DataSet*)data)->x;
-    std::vector<double> y   =   ((struct DataSet*)data)->y;
-
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-
-    //calculate model value and put residual into gsl vector
-    for ( size_t i=0; i < n; i++)
-    {
-        double Yi = p0 + p1*(pow(x[i],6));
-        gsl_vector_set (f, i, Yi - y[i]);
-    }
-    return GSL_SUCCESS;
-}
-
-//derivative
-int psix_df(const gsl_vector *p, void *data, gsl_matrix *J)
-{
-    //unpack data from struct
-    size_t n    =   ((struct DataSet*)data)->n;
-    std::vector<double> x   =   ((struct DataSet*)data)->x;
-    std::vector<double> y   =   ((struct DataSet*)data)->y;
-
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
+////////////////////////////////////////////////////////////////////////
+// Fit models as compile time lists of terms
+//
+//      f(x) = sum_k p_k * term_k(x)
+//
+// A term is any type with a static double eval(double x): a power of p, Power<n>, or
+// an arbitrary function wrapped as Term<fn>. Every model is linear in its parameters,
+// so the Jacobian df_i/dp_k is just term_k(x_i) and comes for free from the same list.
+// The gsl callbacks read the DataSet in place ( no copies per solver iteration ) and the
+// powers are repeated products, not calls to pow. value/gradient serve the fixed size
+// Levenberg-Marquardt backend, DistributionFitter::fitAllFixed.
+////////////////////////////////////////////////////////////////////////
 
-    //Jacobian matrix J(i,j) = dfi * dpj
-    // fi = (Yi - yi)*sigma[i]
-    for ( size_t i=0; i<n; i++ )
-    {
-        gsl_matrix_set(J,i,0,1.0);
-        gsl_matrix_set(J,i,1,1.0*pow(x[i],6));
-    }
-    return GSL_SUCCESS;
-}
-//plain function
-double psix(const gsl_vector *p, double x0)
-{
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-
-    return p0 + p1*pow(x0,6);
-}
-
-/*************************** A + +B*p^2 + C*p^6 *****************************/
-int psq_psix_f(const gsl_vector *p, void *data, gsl_vector *f)
-{
-    //unpack data from struct
-    size_t n    =   ((struct DataSet*)data)->n;
-    std::vector<double> x   =   ((struct DataSet*)data)->x;
-    std::vector<double> y   =   ((struct DataSet*)data)->y;
-
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-    double p2 = gsl_vector_get(p,2);
-
-    //calculate model value and put residual into gsl vector
-    for ( size_t i=0; i < n; i++)
-    {
-        double Yi = p0 + p1*pow(x[i],2) + p2*pow(x[i],6);
-        gsl_vector_set (f, i, Yi - y[i]);
-    }
-    return GSL_SUCCESS;
-}
-
-//derivative
-int psq_psix_df(const gsl_vector *p, void *data, gsl_matrix *J)
+// x^n, negative n allowed
+template<int n>
+struct Power
 {
-    //unpack data from struct
-    size_t n    =   ((struct DataSet*)data)->n;
-    std::vector<double> x   =   ((struct DataSet*)data)->x;
-    std::vector<double> y   =   ((struct DataSet*)data)->y;
-
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-
-    //Jacobian matrix J(i,j) = dfi * dpj
-    // fi = (Yi - yi)*sigma[i]
-    for ( size_t i=0; i<n; i++ )
+    static double eval(double x)
     {
-        gsl_matrix_set(J,i,0,1.0);
-        gsl_matrix_set(J,i,1,1.0*pow(x[i],2));
-        gsl_matrix_set(J,i,2,1.0*pow(x[i],6));
+        double xn = 1.0;
+        for(int k=0;k<(n<0 ? -n : n);k++){ xn *= x; }
+        return (n<0) ? 1.0/xn : xn;
     }
-    return GSL_SUCCESS;
-}
+};
 
-//plain function
-double psq_psix(const gsl_vector *p, double x0)
+// any plain double fn(double)
+template<double (*fn)(double)>
+struct Term
 {
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-    double p2 = gsl_vector_get(p,2);
-
-    return p0 + p1*pow(x0,2) + p2*pow(x0,6);
-}
-
-//Should really change these to take psq as input
+    static double eval(double x){ return fn(x); }
+};
 
-/*************************** A + B*p^2 + C*p^4 + D*p^6 *****************************/
-int polysq_f(const gsl_vector *p, void *data, gsl_vector *f)
+template<class... Terms>
+struct FitModel
 {
-    //unpack data from struct
-    size_t n    =   ((struct DataSet*)data)->n;
-    std::vector<double> x   =   ((struct DataSet*)data)->x;
-    std::vector<double> y   =   ((struct DataSet*)data)->y;
+    static constexpr int nParams = sizeof...(Terms);
 
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-    double p2 = gsl_vector_get(p,2);
-    double p3 = gsl_vector_get(p,3);
-
-    //calculate model value and put residual into gsl vector
-    for ( size_t i=0; i < n; i++)
+    // term_k(x) for all k
+    static void basis(double x, double *b)
     {
-        double Yi = p0 + p1*pow(x[i],2) + p2*pow(x[i],4) + p3*pow(x[i],6);
-        gsl_vector_set (f, i, Yi - y[i]);
+        double terms[] = {Terms::eval(x)...};
+        for(int k=0;k<nParams;k++){ b[k] = terms[k]; }
     }
-    return GSL_SUCCESS;
-}
-
-//derivative
-int polysq_df(const gsl_vector *p, void *data, gsl_matrix *J)
-{
-    //unpack data from struct
-    size_t n    =   ((struct DataSet*)data)->n;
-    std::vector<double> x   =   ((struct DataSet*)data)->x;
-    std::vector<double> y   =   ((struct DataSet*)data)->y;
-
 
-    //Jacobian matrix J(i,j) = dfi * dpj
-    // fi = (Yi - yi)*sigma[i]
-    for ( size_t i=0; i<n; i++ )
+    static double eval(const double *p, size_t stride, double x)
     {
-        gsl_matrix_set(J,i,0,1.0);
-        gsl_matrix_set(J,i,1,1.0*pow(x[i],2));
-        gsl_matrix_set(J,i,2,1.0*pow(x[i],4));
-        gsl_matrix_set(J,i,3,1.0*pow(x[i],6));
+        double b[nParams];
+        basis(x,b);
+        double y = 0;
+        for(int k=0;k<nParams;k++){ y += p[k*stride]*b[k]; }
+        return y;
     }
-    return GSL_SUCCESS;
-}
-
-//plain function
-double polysq(const gsl_vector *p, double x0)
-{
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-    double p2 = gsl_vector_get(p,2);
-    double p3 = gsl_vector_get(p,3);
-
-    return p0 + p1*pow(x0,2) + p2*pow(x0,4) + p3*pow(x0,6);
-}
 
-
-//Should really change these to take psq as input
-
-/*************************** A + B/p^2 + C/p^4 + D/p^6 *****************************/
-int inv_polysq_f(const gsl_vector *p, void *data, gsl_vector *f)
-{
-    //unpack data from struct
-    size_t n    =   ((struct DataSet*)data)->n;
-    std::vector<double> x   =   ((struct DataSet*)data)->x;
-    std::vector<double> y   =   ((struct DataSet*)data)->y;
-
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-    double p2 = gsl_vector_get(p,2);
-    double p3 = gsl_vector_get(p,3);
-
-    //calculate model value and put residual into gsl vector
-    for ( size_t i=0; i < n; i++)
+    // model at every x
+    static void eval(const double *p, const std::vector<double> &x, double *y)
     {
-        double Yi = p0 + p1/pow(x[i],2) + p2/pow(x[i],4) + p3/pow(x[i],6);
-        gsl_vector_set (f, i, Yi - y[i]);
+        for(size_t i=0;i<x.size();i++){ y[i] = eval(p,1,x[i]); }
     }
-    return GSL_SUCCESS;
-}
-
-//derivative
-int inv_polysq_df(const gsl_vector *p, void *data, gsl_matrix *J)
-{
-    //unpack data from struct
-    size_t n    =   ((struct DataSet*)data)->n;
-    std::vector<double> x   =   ((struct DataSet*)data)->x;
-    std::vector<double> y   =   ((struct DataSet*)data)->y;
 
-
-    //Jacobian matrix J(i,j) = dfi * dpj
-    // fi = (Yi - yi)*sigma[i]
-    for ( size_t i=0; i<n; i++ )
+    // residual f_i = Y(x_i) - y_i
+    static int f(const gsl_vector *p, void *data, gsl_vector *f)
     {
-        gsl_matrix_set(J,i,0,1.0);
-        gsl_matrix_set(J,i,1,1.0/pow(x[i],2));
-        gsl_matrix_set(J,i,2,1.0/pow(x[i],4));
-        gsl_matrix_set(J,i,3,1.0/pow(x[i],6));
+        const DataSet &d = *static_cast<const DataSet *>(data);
+        for(size_t i=0;i<d.n;i++)
+        {
+            gsl_vector_set(f,i,eval(p->data,p->stride,d.x[i]) - d.y[i]);
+        }
+        return GSL_SUCCESS;
     }
-    return GSL_SUCCESS;
-}
 
-//plain function
-double inv_polysq(const gsl_vector *p, double x0)
-{
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-    double p2 = gsl_vector_get(p,2);
-    double p3 = gsl_vector_get(p,3);
-
-    return p0 + p1/pow(x0,2) + p2/pow(x0,4) + p3/pow(x0,6);
-}
-
-/*************************** A + B*p^2 + C/p^2  *****************************/
-int psq_psix_psq_inv_psix_inv_f(const gsl_vector *p, void *data, gsl_vector *f)
-{
-    //unpack data from struct
-    size_t n    =   ((struct DataSet*)data)->n;
-    std::vector<double> x   =   ((struct DataSet*)data)->x;
-    std::vector<double> y   =   ((struct DataSet*)data)->y;
-
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-    double p2 = gsl_vector_get(p,2);
-    double p3 = gsl_vector_get(p,3);
-    double p4 = gsl_vector_get(p,4);
-
-    //calculate model value and put residual into gsl vector
-    for ( size_t i=0; i < n; i++)
+    // Jacobian J(i,k) = df_i / dp_k = term_k(x_i)
+    static int df(const gsl_vector *p, void *data, gsl_matrix *J)
     {
-        double Yi = p0 + p1*pow(x[i],2) + p2/pow(x[i],2) + p3*pow(x[i],6) + p4/(x[i],6);
-        gsl_vector_set (f, i, Yi - y[i]);
+        const DataSet &d = *static_cast<const DataSet *>(data);
+        double b[nParams];
+        for(size_t i=0;i<d.n;i++)
+        {
+            basis(d.x[i],b);
+            for(int k=0;k<nParams;k++){ gsl_matrix_set(J,i,k,b[k]); }
+        }
+        return GSL_SUCCESS;
     }
-    return GSL_SUCCESS;
-}
-
-//derivative
-int psq_psix_psq_inv_psix_inv_df(const gsl_vector *p, void *data, gsl_matrix *J)
-{
-    //unpack data from struct
-    size_t n    =   ((struct DataSet*)data)->n;
-    std::vector<double> x   =   ((struct DataSet*)data)->x;
-    std::vector<double> y   =   ((struct DataSet*)data)->y;
 
+    //plain function
+    static double func(const gsl_vector *p, double x0){ return eval(p->data,p->stride,x0); }
 
-    //Jacobian matrix J(i,j) = dfi * dpj
-    // fi = (Yi - yi)*sigma[i]
-    for ( size_t i=0; i<n; i++ )
-    {
-        gsl_matrix_set(J,i,0,1.0);
-        gsl_matrix_set(J,i,1,1.0*pow(x[i],2));
-        gsl_matrix_set(J,i,2,1.0/pow(x[i],2));
-        gsl_matrix_set(J,i,3,1.0*pow(x[i],6));
-        gsl_matrix_set(J,i,4,1.0/pow(x[i],6));
-    }
-    return GSL_SUCCESS;
-}
+    // LMSolver interface ( lm_solver.h ), fixed size parameter vectors
+    template<class P>
+    static double value(const P &p, double x){ return eval(p.data(),1,x); }
 
-//plain function
-double psq_psix_psq_inv_psix_inv(const gsl_vector *p, double x0)
-{
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-    double p2 = gsl_vector_get(p,2);
-    double p3 = gsl_vector_get(p,3);
-    double p4 = gsl_vector_get(p,4);
+    template<class P>
+    static void gradient(const P &p, double x, P &g){ basis(x,g.data()); }
+};
 
-    return p0 + p1*pow(x0,2) + p2/pow(x0,2) + p3*pow(x0,6) + p4/pow(x0,6);
-}
 
-/*************************** A + B*p^2 + C/p^2  *****************************/
-int psq_psq_inv_f(const gsl_vector *p, void *data, gsl_vector *f)
+////////////////////////////////////////////////////////////////////////
+// Registry: every model by name, with its gsl callbacks
+////////////////////////////////////////////////////////////////////////
+struct FitFunction
 {
-    //unpack data from struct
-    size_t n    =   ((struct DataSet*)data)->n;
-    std::vector<double> x   =   ((struct DataSet*)data)->x;
-    std::vector<double> y   =   ((struct DataSet*)data)->y;
+    std::string     name;
+    std::string     formula;
+    int             nParams;
+    int             (*f)(const gsl_vector *, void *, gsl_vector *);
+    int             (*df)(const gsl_vector *, void *, gsl_matrix *);
+    double          (*func)(const gsl_vector *, double);
+    void            (*fit_fixed)(DistributionFitter &);
+};
 
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-    double p2 = gsl_vector_get(p,2);
+template<class Model>
+void fit_all_fixed(DistributionFitter &fitter){ fitter.template fitAllFixed<Model>(); }
 
-    //calculate model value and put residual into gsl vector
-    for ( size_t i=0; i < n; i++)
-    {
-        double Yi = p0 + p1*pow(x[i],2) + p2/pow(x[i],2);
-        gsl_vector_set (f, i, Yi - y[i]);
-    }
-    return GSL_SUCCESS;
-}
-
-//derivative
-int psq_psq_inv_df(const gsl_vector *p, void *data, gsl_matrix *J)
+template<class Model>
+FitFunction make_fit_function(std::string name, std::string formula)
 {
-    //unpack data from struct
-    size_t n    =   ((struct DataSet*)data)->n;
-    std::vector<double> x   =   ((struct DataSet*)data)->x;
-    std::vector<double> y   =   ((struct DataSet*)data)->y;
-
-
-    //Jacobian matrix J(i,j) = dfi * dpj
-    // fi = (Yi - yi)*sigma[i]
-    for ( size_t i=0; i<n; i++ )
-    {
-        gsl_matrix_set(J,i,0,1.0);
-        gsl_matrix_set(J,i,1,1.0*pow(x[i],2));
-        gsl_matrix_set(J,i,2,1.0/pow(x[i],2));
-    }
-    return GSL_SUCCESS;
+    return FitFunction{name,formula,Model::nParams,Model::f,Model::df,Model::func,fit_all_fixed<Model>};
 }
 
-//plain function
-double psq_psq_inv(const gsl_vector *p, double x0)
+const std::vector<FitFunction> & fit_function_registry()
 {
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-    double p2 = gsl_vector_get(p,2);
-
-    return p0 + p1*pow(x0,2) + p2/pow(x0,2);
+    static const std::vector<FitFunction> registry = {
+        make_fit_function<FitModel<Power<0>,Power<-2>>>                                 ("inv_p2",          "A + B/p^2"),
+        make_fit_function<FitModel<Power<0>,Power<-6>>>                                 ("inv_p6",          "A + B/p^6"),
+        make_fit_function<FitModel<Power<0>,Power<-2>,Power<-6>>>                       ("inv_p2_inv_p6",   "A + B/p^2 + C/p^6"),
+        make_fit_function<FitModel<Power<0>,Power<2>,Power<-2>>>                        ("p2_inv_p2",       "A + B*p^2 + C/p^2"),
+        make_fit_function<FitModel<Power<0>,Power<2>>>                                  ("p2",              "A + B*p^2"),
+        make_fit_function<FitModel<Power<0>,Power<6>>>                                  ("p6",              "A + B*p^6"),
+        make_fit_function<FitModel<Power<0>,Power<2>,Power<6>>>                         ("p2_p6",           "A + B*p^2 + C*p^6"),
+        make_fit_function<FitModel<Power<0>,Power<2>,Power<4>,Power<6>>>                ("polysq",          "A + B*p^2 + C*p^4 + D*p^6"),
+        make_fit_function<FitModel<Power<0>,Power<-2>,Power<-4>,Power<-6>>>             ("inv_polysq",      "A + B/p^2 + C/p^4 + D/p^6"),
+        make_fit_function<FitModel<Power<0>,Power<2>,Power<-2>,Power<6>,Power<-6>>>     ("p2_inv_p2_p6_inv_p6","A + B*p^2 + C/p^2 + D*p^6 + E/p^6"),
+        make_fit_function<FitModel<Power<0>,Power<1>>>                                  ("linear",          "A + B*x")};
+    return registry;
 }
 
-
-/*************************** A + B*x  *****************************/
-int linear_f(const gsl_vector *p, void *data, gsl_vector *f)
+// model by name, false if unknown
+bool find_fit_function(const std::string &name, FitFunction &model)
 {
-    //unpack data from struct
-    size_t n    =   ((struct DataSet*)data)->n;
-    std::vector<double> x   =   ((struct DataSet*)data)->x;
-    std::vector<double> y   =   ((struct DataSet*)data)->y;
-
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-
-    //calculate model value and put residual into gsl vector
-    for ( size_t i=0; i < n; i++)
+    for(auto &entry : fit_function_registry())
     {
-        double Yi = p0 + p1*x[i];
-        gsl_vector_set (f, i, Yi - y[i]);
+        if(entry.name == name)
+        {
+            model = entry;
+            return true;
+        }
     }
-    return GSL_SUCCESS;
+    return false;
 }
 
-//derivative
-int linear_df(const gsl_vector *p, void *data, gsl_matrix *J)
+std::string fit_function_names()
 {
-    //unpack data from struct
-    size_t n    =   ((struct DataSet*)data)->n;
-    std::vector<double> x   =   ((struct DataSet*)data)->x;
-    std::vector<double> y   =   ((struct DataSet*)data)->y;
-
-
-    //Jacobian matrix J(i,j) = dfi * dpj
-    // fi = (Yi - yi)*sigma[i]
-    for ( size_t i=0; i<n; i++ )
-    {
-        gsl_matrix_set(J,i,0,1.0);
-        gsl_matrix_set(J,i,1,x[i]);
-    }
-    return GSL_SUCCESS;
-}
-
-//plain function
-double linear(const gsl_vector *p, double x0)
-{
-    // get parameters
-    double p0 = gsl_vector_get(p,0);
-    double p1 = gsl_vector_get(p,1);
-
-    return p0 + p1*x0;
+    std::string names;
+    for(auto &entry : fit_function_registry()){ names += (names.empty() ? "" : ", ") + entry.name; }
+    return names;
 }
 
-
-//Should really change these to take psq as input
-
-//Should really change these to take psq as input
-
-
 #endif
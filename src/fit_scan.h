@@ -0,0 +1,223 @@
+#ifndef FIT_SCAN_H
+#define FIT_SCAN_H
+
+#include "AnalysisNPR.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <limits>
+#include <cmath>
+#include <numeric>
+#include <algorithm>
+#include <Grid/Eigen/Dense>
+
+////////////////////////////////////////////////////////////////////////
+// Scan over fit windows and models
+//
+// Every contiguous window of the momenta ( sorted ) with at least one degree of freedom
+// is fitted with every model of the registry, weighted by 1/sigma^2 of the points so the
+// chi^2 are comparable. All the models are linear in their parameters: the basis is built
+// once per model and each window QR factorises its own whitened rows sqrt(w) A ( at most
+// nPoints x np ) once for all its samples, as LinearFitter does, so the p^-6 ... p^6 terms
+// keep their precision. The fits are ranked by
+//
+//      AIC = chi^2 + 2 nParams + 2 nCut
+//
+// ( nCut points outside the window ) and averaged with weights exp(-AIC/2).
+////////////////////////////////////////////////////////////////////////
+
+struct ScanResult
+{
+    std::string                         model;
+    int                                 nParams;
+    double                              p_min, p_max;
+    int                                 nPoints;
+    double                              chisq;          // central sample
+    double                              aic;
+    double                              weight;
+    std::vector<std::vector<double>>    extrap;         // [point][sample]
+};
+
+class FitScan
+{
+    private:
+        int                                 nSamples, nPoints;
+        std::string                         resamplingType;
+        std::vector<double>                 x;
+        Eigen::VectorXd                     sqrt_weights;
+        Eigen::MatrixXd                     Y;              // (points x samples), sqrt(w) y, sorted in x
+        std::vector<double>                 x_extrap;       // of the last run
+
+        // parameters ( np x samples ) of the points first..last with basis A, false if degenerate
+        bool solve(const Eigen::MatrixXd &A, int first, int last, Eigen::MatrixXd &P);
+
+    public:
+        FitScan(Distribution<std::vector<double>> y, std::vector<double> x);
+
+        // all windows and models, ranked by AIC, extrapolated to x_extrap
+        std::vector<ScanResult> run(const std::vector<double> &x_extrap, const std::vector<FitFunction> &models=fit_function_registry());
+
+        // AIC weighted average [point][sample], systematic error from the spread of the central values
+        std::vector<std::vector<double>> average(const std::vector<ScanResult> &results, std::vector<double> &sys);
+
+        // the window of all points against LinearFitter for every model
+        bool check(const std::vector<FitFunction> &models=fit_function_registry());
+};
+
+FitScan::FitScan(Distribution<std::vector<double>> y, std::vector<double> x_in)
+{
+    nSamples        = y.get_values().size();
+    nPoints         = x_in.size();
+    resamplingType  = y.get_resamplingType();
+
+    std::vector<int> order(nPoints);
+    std::iota(order.begin(),order.end(),0);
+    std::sort(order.begin(),order.end(),[&](int a, int b){ return x_in[a] < x_in[b]; });
+
+    std::vector<double> sigma = y.get_std();
+    x.resize(nPoints);
+    sqrt_weights.resize(nPoints);
+    Y.resize(nPoints,nSamples);
+    for (int i=0; i<nPoints; i++)
+    {
+        x[i]            = x_in[order[i]];
+        sqrt_weights(i) = 1.0/sigma[order[i]];
+        for (int s=0; s<nSamples; s++){ Y(i,s) = sqrt_weights(i)*y.get_value(s)[order[i]]; }
+    }
+}
+
+bool FitScan::solve(const Eigen::MatrixXd &A, int first, int last, Eigen::MatrixXd &P)
+{
+    int len = last-first+1;
+    Eigen::ColPivHouseholderQR<Eigen::MatrixXd> qr(sqrt_weights.segment(first,len).asDiagonal()*A.middleRows(first,len));
+    // degenerate window ( repeated momenta )
+    if(qr.rank() < A.cols()){ return false; }
+    P = qr.solve(Y.middleRows(first,len));
+    return true;
+}
+
+std::vector<ScanResult> FitScan::run(const std::vector<double> &x_extrap, const std::vector<FitFunction> &models)
+{
+    this->x_extrap = x_extrap;
+    // tasks: (model, first, last) with at least one degree of freedom
+    struct Task { int model, first, last; };
+    std::vector<Task> tasks;
+    for (int m=0; m<models.size(); m++)
+    for (int first=0; first<nPoints; first++)
+    for (int last=first+models[m].nParams; last<nPoints; last++)
+    {
+        tasks.push_back({m,first,last});
+    }
+
+    std::vector<Eigen::MatrixXd>    basis(models.size()), basis_extrap(models.size());
+    for (int m=0; m<models.size(); m++)
+    {
+        basis[m]        = linear_basis(models[m].df,x,models[m].nParams);
+        basis_extrap[m] = linear_basis(models[m].df,x_extrap,models[m].nParams);
+    }
+
+    std::vector<ScanResult> results(tasks.size());
+    parallel_for (int t=0; t<(int)tasks.size(); t++)
+    {
+        const Task &task    = tasks[t];
+        int np              = models[task.model].nParams;
+        int len             = task.last-task.first+1;
+
+        ScanResult &r   = results[t];
+        r.model         = models[task.model].name;
+        r.nParams       = np;
+        r.p_min         = x[task.first];
+        r.p_max         = x[task.last];
+        r.nPoints       = len;
+        Eigen::MatrixXd P;
+        if(!solve(basis[task.model],task.first,task.last,P))
+        {
+            // never selected
+            r.chisq = r.aic = std::numeric_limits<double>::infinity();
+            continue;
+        }
+
+        // chi^2 of the central value ( last sample, or the mean without resampling ) from its residuals
+        Eigen::VectorXd Yc  = (resamplingType == "none") ? Eigen::VectorXd(Y.middleRows(task.first,len).rowwise().mean()) : Eigen::VectorXd(Y.block(task.first,nSamples-1,len,1));
+        Eigen::VectorXd Pc  = (resamplingType == "none") ? Eigen::VectorXd(P.rowwise().mean()) : Eigen::VectorXd(P.col(nSamples-1));
+        Eigen::VectorXd res = Yc - sqrt_weights.segment(task.first,len).asDiagonal()*basis[task.model].middleRows(task.first,len)*Pc;
+        r.chisq = res.squaredNorm();
+        r.aic   = r.chisq + 2*np + 2*(nPoints-len);
+
+        Eigen::MatrixXd f = basis_extrap[task.model]*P;
+        r.extrap.assign(x_extrap.size(),std::vector<double>(nSamples));
+        for (int j=0; j<x_extrap.size(); j++)
+        for (int s=0; s<nSamples; s++)
+        {
+            r.extrap[j][s] = f(j,s);
+        }
+    }
+
+    // weights relative to the best fit, then ranked
+    double aic_min = std::numeric_limits<double>::infinity();
+    for (auto &r : results){ aic_min = std::min(aic_min,r.aic); }
+    double norm = 0;
+    for (auto &r : results)
+    {
+        r.weight    = (std::isfinite(r.aic)) ? std::exp(-0.5*(r.aic-aic_min)) : 0.0;
+        norm       += r.weight;
+    }
+    for (auto &r : results){ r.weight = (norm > 0) ? r.weight/norm : 0; }
+    std::stable_sort(results.begin(),results.end(),[](const ScanResult &a, const ScanResult &b){ return a.aic < b.aic; });
+    return results;
+}
+
+std::vector<std::vector<double>> FitScan::average(const std::vector<ScanResult> &results, std::vector<double> &sys)
+{
+    int nExtrap = x_extrap.size();
+    std::vector<std::vector<double>> avg(nExtrap,std::vector<double>(nSamples,0.0));
+    sys.assign(nExtrap,0.0);
+    for (int j=0; j<nExtrap; j++)
+    {
+        for (auto &r : results)
+        {
+            if(r.weight == 0){ continue; }
+            for (int s=0; s<nSamples; s++){ avg[j][s] += r.weight*r.extrap[j][s]; }
+        }
+        double central = Distribution<double>(avg[j],resamplingType).get_central();
+        for (auto &r : results)
+        {
+            if(r.weight == 0){ continue; }
+            double d = Distribution<double>(r.extrap[j],resamplingType).get_central() - central;
+            sys[j] += r.weight*d*d;
+        }
+        sys[j] = Grid::sqrt(sys[j]);
+    }
+    return avg;
+}
+
+bool FitScan::check(const std::vector<FitFunction> &models)
+{
+    std::vector<double> weights(nPoints);
+    Eigen::MatrixXd     y(nPoints,nSamples);
+    for (int i=0; i<nPoints; i++)
+    {
+        weights[i]  = sqrt_weights(i)*sqrt_weights(i);
+        y.row(i)    = Y.row(i)/sqrt_weights(i);
+    }
+
+    bool pass = true;
+    for (auto &model : models)
+    {
+        if(model.nParams >= nPoints){ continue; }
+        Eigen::MatrixXd P;
+        bool ok = solve(linear_basis(model.df,x,model.nParams),0,nPoints-1,P);
+        LinearFitter    linfit(model.df,x,model.nParams,weights);
+        if(linfit.rank() < model.nParams){ continue; }
+        Eigen::MatrixXd P_ref = linfit.solve(y);
+        double diff = (ok) ? (P-P_ref).norm()/P_ref.norm() : std::numeric_limits<double>::infinity();
+        if(!(diff < 1e-8))
+        {
+            std::cout << "Error: scan fit of " << model.name << " over all points differs from LinearFitter by " << diff << std::endl;
+            pass = false;
+        }
+    }
+    return pass;
+}
+
+#endif
@@ -5,12 +5,20 @@
 #include "AnalysisNPR.h"
 #include <iostream>
 #include <vector>
+#include <string>
 #include <gsl/gsl_multifit_nlinear.h>
 #include <gsl/gsl_matrix.h>
 #include <gsl/gsl_vector.h>
 #include <gsl/gsl_rng.h>
 #include <gsl/gsl_randist.h>
 #include <gsl/gsl_multifit_nlin.h>
+#include <Grid/Eigen/Dense>
+#include <memory>
+#include <algorithm>
+#include "lm_solver.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 ////////////////////////////////////////////////////////////////////////
 // Kind of hacky wrapper class for gsl minimiser. 
@@ -27,18 +35,79 @@ struct DataSet
     size_t              n;
 };
 
+// fitted function on a grid of points, one entry per point. central and std follow
+// Distribution, lower/upper are percentiles of the resamples ( jackknife rescaled )
+struct ErrorBand
+{
+    std::vector<double> x;
+    std::vector<double> central;
+    std::vector<double> std;
+    std::vector<double> lower;
+    std::vector<double> upper;
+};
+
 ////////////////////////////////
 
+////////////////////////////////////////////////////
+// gsl solver, Jacobian and covariance for fits of n points with np parameters.
+// Allocated once and reset by each fit ( fdfsolver_wset ), so one per thread
+// serves any number of fits.
+////////////////////////////////////////////////////
+struct FitWorkspace
+{
+    size_t                      n, np;
+    gsl_multifit_fdfsolver      *s;
+    gsl_matrix                  *J, *covar;
+
+    FitWorkspace(size_t n, size_t np) : n(n), np(np)
+    {
+        s       = gsl_multifit_fdfsolver_alloc(gsl_multifit_fdfsolver_lmsder, n, np);
+        J       = gsl_matrix_alloc(n, np);
+        covar   = gsl_matrix_alloc(np, np);
+    }
+    ~FitWorkspace()
+    {
+        gsl_multifit_fdfsolver_free(s);
+        gsl_matrix_free(covar);
+        gsl_matrix_free(J);
+    }
+    FitWorkspace(const FitWorkspace &) = delete;
+    FitWorkspace & operator=(const FitWorkspace &) = delete;
+};
+
+inline int fit_thread_num()
+{
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+inline int fit_max_threads()
+{
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
 ////////////////////////////////////////////////////
 // wrapper class for GSL minimiser for least sq
 // requires user 
+// minimise() uses a workspace of its own, kept for refits until free(),
+// minimise(workspace) a shared one; the fitted parameters, their errors, the
+// iteration count and the method are copied out so they outlive the workspace.
 class Fitter
 {
     private:
         DataSet data;
+        std::shared_ptr<FitWorkspace> own;
     public:
         Fitter(DataSet d);
         int minimise();
+        int minimise(FitWorkspace &workspace);
         void printResults();
         void free();
 
@@ -46,14 +115,16 @@ class Fitter
         size_t  n, np;
         double chi, chi0;
         int status, info;
+        size_t iterations;
+        size_t maxIter = 20;
 
-        std::vector<double> p_init, weights;
+        std::vector<double> p_init, weights, result;
+        // sqrt of the covariance diagonal
+        std::vector<double> errors;
+        std::string         method;
 
         const gsl_multifit_fdfsolver_type *T = gsl_multifit_fdfsolver_lmsder;
-        gsl_multifit_fdfsolver *s;
         gsl_multifit_function_fdf fdf;
-        gsl_vector *res_f;
-        gsl_matrix *J, *covar;
         
         gsl_vector_view sgm, wght,pars;
 
@@ -69,39 +140,41 @@ Fitter::Fitter(DataSet d)
     this->data      = d;
     this->n         = d.n;
     this->weights   = std::vector<double>(n,1.0);
-    
-    //set up weights and errors
-    sgm = gsl_vector_view_array(&(data.sigma[0]), n);
-    wght = gsl_vector_view_array(&weights[0], n);
-    
 }
 
 void Fitter::free()
 {
     // free up the solvers and covariance and Jacobian matrices 
-    gsl_multifit_fdfsolver_free (s);
-    gsl_matrix_free (covar);
-    gsl_matrix_free (J);
-
+    own.reset();
 }
 
 int Fitter::minimise()
 {
-    J = gsl_matrix_alloc(n, np);
-    covar = gsl_matrix_alloc (np, np);
+    if(!own || own->n != n || own->np != np){ own = std::make_shared<FitWorkspace>(n, np); }
+    return minimise(*own);
+}
+
+int Fitter::minimise(FitWorkspace &workspace)
+{
+    gsl_multifit_fdfsolver  *s      = workspace.s;
+    gsl_matrix              *J      = workspace.J;
+    gsl_matrix              *covar  = workspace.covar;
+
+    //set up weights and errors here, the views must point into this copy of the fitter
+    sgm = gsl_vector_view_array(&(data.sigma[0]), n);
+    wght = gsl_vector_view_array(&weights[0], n);
     pars = gsl_vector_view_array (&p_init[0], np);
 
     fdf.n = n;
     fdf.p = np;
     fdf.params = &data;
-    s = gsl_multifit_fdfsolver_alloc (T, n, np);
 
 
     /* initialize solver with starting point and weights */
     gsl_multifit_fdfsolver_wset (s, &fdf, &pars.vector, &wght.vector);
 
     /* compute initial residual norm */
-    res_f = gsl_multifit_fdfsolver_residual(s);
+    gsl_vector *res_f = gsl_multifit_fdfsolver_residual(s);
 
     chi0=0;
     for (size_t i=0;i<res_f->size;i++)
@@ -110,8 +183,9 @@ int Fitter::minimise()
     }
     chi0 = Grid::sqrt(chi0);
 
-    /* solve the system with a maximum of 20 iterations */
-    status = gsl_multifit_fdfsolver_driver(s, 20, xtol, gtol, ftol, &info);
+    /* solve the system with a maximum of maxIter iterations */
+    status = gsl_multifit_fdfsolver_driver(s, maxIter, xtol, gtol, ftol, &info);
+    iterations = gsl_multifit_fdfsolver_niter(s);
 
     gsl_multifit_fdfsolver_jac(s, J);
     gsl_multifit_covar (J, 0.0, covar);
@@ -124,18 +198,27 @@ int Fitter::minimise()
     }
     chi = Grid::sqrt(chi);
 
+    result.resize(np);
+    errors.resize(np);
+    for (size_t i=0;i<np;i++)
+    {
+        result[i] = gsl_vector_get(s->x,i);
+        errors[i] = Grid::sqrt(gsl_matrix_get(covar,i,i));
+    }
+    method = gsl_multifit_fdfsolver_name(s);
+    return status;
 }
 
 void Fitter::printResults()
 {
 
-    #define FIT(i) gsl_vector_get(s->x, i)
-    #define ERR(i) Grid::sqrt(gsl_matrix_get(covar,i,i))
+    #define FIT(i) result[i]
+    #define ERR(i) errors[i]
 
     fprintf(stderr, "summary from method '%s'\n",
-                    gsl_multifit_fdfsolver_name(s));
+                    method.c_str());
     fprintf(stderr, "number of iterations: %zu\n",
-                      gsl_multifit_fdfsolver_niter(s));
+                      iterations);
     fprintf(stderr, "function evaluations: %zu\n", fdf.nevalf);
     fprintf(stderr, "Jacobian evaluations: %zu\n", fdf.nevaldf);
     fprintf(stderr, "reason for stopping: %s\n",
@@ -160,6 +243,111 @@ fprintf (stderr, "status = %s\n", gsl_strerror (status));
 
 
 
+// basis functions of a linear model at x, A(i,k), its Jacobian for any parameters
+Eigen::MatrixXd linear_basis(int (*df)(const gsl_vector *, void *, gsl_matrix *), const std::vector<double> &x, int np)
+{
+    DataSet data;
+    data.x      = x;
+    data.y      = std::vector<double>(x.size(),0.0);
+    data.sigma  = std::vector<double>(x.size(),1.0);
+    data.n      = x.size();
+
+    // any parameters will do, the Jacobian of a linear model does not depend on them
+    std::vector<double> p(np,1.0);
+    gsl_vector_view pars = gsl_vector_view_array(&p[0],np);
+    gsl_matrix *J = gsl_matrix_alloc(x.size(),np);
+    df(&pars.vector,&data,J);
+
+    Eigen::MatrixXd A(x.size(),np);
+    for(int i=0;i<x.size();i++)
+    for(int k=0;k<np;k++)
+    {
+        A(i,k) = gsl_matrix_get(J,i,k);
+    }
+    gsl_matrix_free(J);
+    return A;
+}
+
+////////////////////////////////////////////////////
+// Linear least squares for models linear in their parameters ( all of fit_functions.h ).
+// The Jacobian df of such a model is its design matrix A(i,k) = g_k(x_i) of its basis functions g_k,
+// independent of the parameters. x and the weights are the same for every sample, so
+// sqrt(w) A is QR factorised once and every sample is solved together,
+//      P = R^-1 Q^T sqrt(w) Y          ( Y = n x nSamples, P = np x nSamples )
+// For correlated fits the weights are replaced by the Cholesky factor C = L L^T of the
+// covariance, whitening with L^-1 instead of sqrt(w) so |L^-1 r|^2 = r^T C^-1 r is the chi^2.
+////////////////////////////////////////////////////
+class LinearFitter
+{
+    private:
+        int                                     np;
+        int                                     (*df)(const gsl_vector *, void *, gsl_matrix *);
+        Eigen::MatrixXd                         design;
+        Eigen::VectorXd                         sqrt_weights;
+        Eigen::MatrixXd                         cholesky;
+        Eigen::ColPivHouseholderQR<Eigen::MatrixXd> qr;
+
+        Eigen::MatrixXd whiten(const Eigen::MatrixXd &m);
+        void            factorise();
+
+    public:
+        LinearFitter(int (*df)(const gsl_vector *, void *, gsl_matrix *), std::vector<double> x, int np, std::vector<double> weights);
+        // correlated, L the lower Cholesky factor of the covariance of the points
+        LinearFitter(int (*df)(const gsl_vector *, void *, gsl_matrix *), std::vector<double> x, int np, const Eigen::MatrixXd &cholesky);
+
+        // basis functions of the model at x, A(i,k)
+        Eigen::MatrixXd basis(std::vector<double> x);
+        // parameters of all samples
+        Eigen::MatrixXd solve(const Eigen::MatrixXd &y);
+        // |f(x)| = sqrt( sum w r^2 ) ( or sqrt( r^T C^-1 r ) ) of all samples, as Fitter::chi
+        Eigen::VectorXd residual_norm(const Eigen::MatrixXd &y, const Eigen::MatrixXd &params);
+        int             rank(){ return qr.rank(); }
+};
+
+LinearFitter::LinearFitter(int (*df)(const gsl_vector *, void *, gsl_matrix *), std::vector<double> x, int np, std::vector<double> weights) : np(np), df(df)
+{
+    design          = basis(x);
+    sqrt_weights    = Eigen::Map<Eigen::VectorXd>(weights.data(),weights.size()).cwiseSqrt();
+    factorise();
+}
+
+LinearFitter::LinearFitter(int (*df)(const gsl_vector *, void *, gsl_matrix *), std::vector<double> x, int np, const Eigen::MatrixXd &cholesky) : np(np), df(df), cholesky(cholesky)
+{
+    design          = basis(x);
+    factorise();
+}
+
+Eigen::MatrixXd LinearFitter::whiten(const Eigen::MatrixXd &m)
+{
+    if(cholesky.size() > 0){ return cholesky.triangularView<Eigen::Lower>().solve(m); }
+    return sqrt_weights.asDiagonal()*m;
+}
+
+void LinearFitter::factorise()
+{
+    qr.compute(whiten(design));
+    if(qr.rank() < np)
+    {
+        std::cout << "Warning: linear fit design matrix has rank " << qr.rank() << " < " << np << " parameters" << std::endl;
+    }
+}
+
+Eigen::MatrixXd LinearFitter::basis(std::vector<double> x)
+{
+    return linear_basis(df,x,np);
+}
+
+Eigen::MatrixXd LinearFitter::solve(const Eigen::MatrixXd &y)
+{
+    return qr.solve(whiten(y));
+}
+
+Eigen::VectorXd LinearFitter::residual_norm(const Eigen::MatrixXd &y, const Eigen::MatrixXd &params)
+{
+    return whiten(design*params - y).colwise().norm().transpose();
+}
+
+
 // hacky jackknife fitter surely a more efficient way
 class DistributionFitter
 {
@@ -175,13 +363,45 @@ class DistributionFitter
 
         std::vector<std::vector<double>>    params;
         std::vector<double>                 chi;
+        std::vector<size_t>                 iterations;
+
+        // starting point from assignFitFunction, resamples start from the central fit if warmStart
+        std::vector<double>                 p_start;
+        bool                                warmStart = true;
+        // fits stopping at the iteration cap are retried once from p_start with retryFactor x the cap
+        size_t                              maxIter = 20;
+        int                                 retryFactor = 5;
+        int                                 retried = 0, failures = 0;
+
+        template<class Attempt> int     fitSample(int i, std::vector<double> start, Attempt attempt);
+        template<class Attempt> void    fitSamples(Attempt attempt);
+
+        // one gsl workspace per thread, kept between fitAll calls
+        std::vector<std::shared_ptr<FitWorkspace>> workspaces;
 
         double          (*function)(const gsl_vector *, double);
+        int             (*jacobian)(const gsl_vector *, void *, gsl_matrix *);
+        bool            linear = false;
+        Eigen::MatrixXd linearParams;
+        bool            correlated = false;
+        Eigen::MatrixXd cholesky;
     public:
         DistributionFitter(Distribution<std::vector<double>> y, std::vector<double> x);
         void assignFitFunction( int (*f)(const gsl_vector *, void *, gsl_vector *),  int(*df)(const gsl_vector *, void *, gsl_matrix *), double(*func)(const gsl_vector *, double), std::vector<double> p_init );
         void fitAll();
         void fit(int i);
+        // same, with the fixed size Levenberg-Marquardt solver ( lm_solver.h ) and Model inlined
+        template<class Model>
+        void fitAllFixed();
+        // linear models only: one factorisation for all samples
+        void fitAllLinear();
+        // fit with the covariance of the points over the resamples, shrunk towards its diagonal
+        bool setCorrelated(double shrinkage=0.0);
+        void setWarmStart(bool warm){ warmStart = warm; }
+
+        // samples which did not converge even after the retry
+        int                                 get_failures(){ return failures; }
+        std::vector<size_t>                 get_iterations(){ return iterations; }
 
         // get functions
         std::vector<std::vector<double>>    get_params(){ return params; }
@@ -189,6 +409,12 @@ class DistributionFitter
         
         //extrapolate function
         std::vector<double>                 extrapolate(double x0); 
+        // several points, [point][sample]; one matrix product after fitAllLinear
+        std::vector<std::vector<double>>    extrapolate(std::vector<double> x0);
+        // (points x samples)
+        Eigen::MatrixXd                     evaluate(const std::vector<double> &x0);
+        // central, std and the band holding the fraction cl of the samples at each point
+        ErrorBand                           errorBand(const std::vector<double> &x0, double cl=0.68);
 
 };
 
@@ -214,6 +440,7 @@ DistributionFitter::DistributionFitter(Distribution<std::vector<double>> y, std:
 
     chi.resize(nSamples);
     params.resize(nSamples);
+    iterations.resize(nSamples);
 }
 
 void DistributionFitter::assignFitFunction( int (*f)(const gsl_vector *, void *, gsl_vector *), int(*df)(const gsl_vector *, void *, gsl_matrix *), double(*func)(const gsl_vector *, double), std::vector<double> p_init )
@@ -226,7 +453,9 @@ void DistributionFitter::assignFitFunction( int (*f)(const gsl_vector *, void *,
         fitters[i].np = nParams;
         fitters[i].p_init = p_init;
     }
+    p_start  = p_init;
     function = func;
+    jacobian = df;
 }
 
 void DistributionFitter::fit(int i)
@@ -234,18 +463,180 @@ void DistributionFitter::fit(int i)
     fitters[i].minimise();
 }
 
-void DistributionFitter::fitAll()
+// fit sample i, retrying from p_start with retryFactor x the cap if the first attempt does not converge.
+// attempt(i,start,cap) makes one fit, sets params[i] and chi[i] and returns the gsl status and iterations.
+// returns 0 if converged first time, 1 if converged on the retry, 2 if not converged at all
+template<class Attempt>
+int DistributionFitter::fitSample(int i, std::vector<double> start, Attempt attempt)
 {
+    size_t its;
+    int outcome = 0;
+    if(attempt(i,start,maxIter,its) != GSL_SUCCESS)
+    {
+        size_t retry;
+        outcome = (attempt(i,p_start,maxIter*retryFactor,retry) == GSL_SUCCESS) ? 1 : 2;
+        its += retry;
+    }
+    iterations[i] = its;
+    return outcome;
+}
+
+// central value first ( last sample, or the only one ), then the resamples in parallel, started from it
+template<class Attempt>
+void DistributionFitter::fitSamples(Attempt attempt)
+{
+    linear = false;
+    int central = nSamples-1;
+    std::vector<int> outcome(nSamples,0);
+    outcome[central] = fitSample(central,p_start,attempt);
+    std::vector<double> start = (warmStart) ? params[central] : p_start;
+    parallel_for (int i=0; i<central; i++)
+    {
+        outcome[i] = fitSample(i,start,attempt);
+    }
+
+    retried = failures = 0;
+    size_t total = 0;
     for (int i=0; i<nSamples; i++)
     {
-        fitters[i].minimise();    
-        chi[i] = (fitters[i].chi);
-        chi[i] = (fitters[i].chi);
-        for (int j=0; j<nParams; j++)
+        retried     += (outcome[i] > 0);
+        failures    += (outcome[i] > 1);
+        total       += iterations[i];
+    }
+    std::cout << "Nonlinear fits: " << double(total)/nSamples << " iterations per sample";
+    if(retried){ std::cout << ", " << retried << " retried"; }
+    std::cout << std::endl;
+    if(failures)
+    {
+        std::cout << "Warning: " << failures << " of " << nSamples << " fits did not converge"
+                  << ((outcome[central] > 1) ? " including the central fit" : "") << std::endl;
+    }
+}
+
+void DistributionFitter::fitAll()
+{
+    if(correlated)
+    {
+        std::cout << "Correlated fits use the linear solver" << std::endl;
+        fitAllLinear();
+        return;
+    }
+    // workspaces allocated once, each thread reuses its own for every sample it fits;
+    // results are written by sample index so the ordering does not depend on the schedule
+    if((int)workspaces.size() < fit_max_threads() || workspaces[0]->n != fitters[0].n || workspaces[0]->np != static_cast<size_t>(nParams))
+    {
+        workspaces.clear();
+        for (int t=0; t<fit_max_threads(); t++)
         {
-            params[i].push_back(gsl_vector_get(fitters[i].s->x, j));
+            workspaces.push_back(std::make_shared<FitWorkspace>(fitters[0].n, nParams));
         }
     }
+
+    fitSamples([&](int i, const std::vector<double> &start, size_t cap, size_t &its)
+    {
+        Fitter &fitter  = fitters[i];
+        fitter.p_init   = start;
+        fitter.maxIter  = cap;
+        fitter.minimise(*workspaces[fit_thread_num()]);
+        chi[i]          = fitter.chi;
+        params[i]       = fitter.result;
+        its             = fitter.iterations;
+        return fitter.status;
+    });
+}
+
+template<class Model>
+void DistributionFitter::fitAllFixed()
+{
+    typedef LMSolver<Model> Solver;
+    if(Model::nParams != nParams)
+    {
+        std::cout << "Error: model has " << Model::nParams << " parameters, fit function " << nParams << std::endl;
+        return;
+    }
+    if(correlated)
+    {
+        std::cout << "Correlated fits use the linear solver" << std::endl;
+        fitAllLinear();
+        return;
+    }
+
+    fitSamples([&](int i, const std::vector<double> &start, size_t cap, size_t &its)
+    {
+        Solver solver(cap);
+        typename Solver::Params p = Eigen::Map<const typename Solver::Params>(start.data());
+        int status  = solver.solve(data[i].x.data(),data[i].y.data(),data[i].n,p);
+        chi[i]      = solver.chi;
+        params[i]   = std::vector<double>(p.data(),p.data()+nParams);
+        its         = solver.iterations;
+        return status;
+    });
+}
+
+void DistributionFitter::fitAllLinear()
+{
+    // same data and weights as the minimiser
+    LinearFitter linfit = correlated ? LinearFitter(jacobian,data[0].x,nParams,cholesky) : LinearFitter(jacobian,data[0].x,nParams,fitters[0].weights);
+
+    Eigen::MatrixXd Y(data[0].n,nSamples);
+    for (int i=0; i<nSamples; i++)
+    {
+        Y.col(i) = Eigen::Map<Eigen::VectorXd>(data[i].y.data(),data[i].n);
+    }
+
+    linearParams                = linfit.solve(Y);
+    Eigen::VectorXd residuals   = linfit.residual_norm(Y,linearParams);
+    for (int i=0; i<nSamples; i++)
+    {
+        chi[i]      = residuals(i);
+        params[i]   = std::vector<double>(linearParams.col(i).data(),linearParams.col(i).data()+nParams);
+    }
+    linear = true;
+}
+
+////////////////////////////////////////////////////
+// Covariance of the points over the resamples, with the same central value and
+// normalisation as Distribution::get_std, accumulated as one symmetric rank update
+// ( blocked and vectorised by Eigen ). shrinkage 0 <= s <= 1 gives (1-s) C + s diag(C).
+// Factorised once here, the Cholesky factor then whitens the fits of all samples.
+////////////////////////////////////////////////////
+bool DistributionFitter::setCorrelated(double shrinkage)
+{
+    if(shrinkage < 0 || shrinkage > 1)
+    {
+        std::cout << "Error: shrinkage " << shrinkage << " must be between 0 and 1. Fitting uncorrelated" << std::endl;
+        correlated = false;
+        return false;
+    }
+    int n       = data[0].n;
+    int nMeas   = (resamplingType == "none") ? nSamples : nSamples-1;
+    double factor = (resamplingType == "jackknife") ? nMeas-1 : 1;
+
+    Eigen::MatrixXd Y(n,nSamples);
+    for (int i=0; i<nSamples; i++)
+    {
+        Y.col(i) = Eigen::Map<Eigen::VectorXd>(data[i].y.data(),n);
+    }
+    Eigen::VectorXd central = (resamplingType == "none") ? Eigen::VectorXd(Y.rowwise().mean()) : Eigen::VectorXd(Y.col(nSamples-1));
+    Eigen::MatrixXd deviation = Y.colwise() - central;
+
+    Eigen::MatrixXd covariance = Eigen::MatrixXd::Zero(n,n);
+    covariance.selfadjointView<Eigen::Lower>().rankUpdate(deviation,factor/nMeas);
+    covariance = covariance.selfadjointView<Eigen::Lower>();
+
+    Eigen::MatrixXd diagonal = covariance.diagonal().asDiagonal();
+    covariance = (1.0-shrinkage)*covariance + shrinkage*diagonal;
+
+    Eigen::LLT<Eigen::MatrixXd> llt(covariance);
+    if(llt.info() != Eigen::Success)
+    {
+        std::cout << "Error: covariance of the fit data is not positive definite, try shrinkage > 0. Fitting uncorrelated" << std::endl;
+        correlated = false;
+        return false;
+    }
+    cholesky    = llt.matrixL();
+    correlated  = true;
+    return true;
 }
 
 std::vector<double>  DistributionFitter::extrapolate(double x0)
@@ -253,9 +644,92 @@ std::vector<double>  DistributionFitter::extrapolate(double x0)
     std::vector<double> extrap_vector;
     for (int i=0; i<nSamples; i++)
     {
-        extrap_vector.push_back(function(fitters[i].s->x,x0));
+        gsl_vector_view p = gsl_vector_view_array(&params[i][0],nParams);
+        extrap_vector.push_back(function(&p.vector,x0));
     }
     return extrap_vector;
 }
 
+std::vector<std::vector<double>> DistributionFitter::extrapolate(std::vector<double> x0)
+{
+    Eigen::MatrixXd f = evaluate(x0);
+    std::vector<std::vector<double>> extrap(x0.size(),std::vector<double>(nSamples));
+    for(int j=0;j<x0.size();j++)
+    for(int i=0;i<nSamples;i++)
+    {
+        extrap[j][i] = f(j,i);
+    }
+    return extrap;
+}
+
+Eigen::MatrixXd DistributionFitter::evaluate(const std::vector<double> &x0)
+{
+    Eigen::MatrixXd f(x0.size(),nSamples);
+    if(linear)
+    {
+        // one matrix product for the whole grid
+        f.noalias() = linear_basis(jacobian,x0,nParams)*linearParams;
+        return f;
+    }
+    parallel_for (int j=0; j<(int)x0.size(); j++)
+    {
+        for (int i=0; i<nSamples; i++)
+        {
+            gsl_vector_view p = gsl_vector_view_array(&params[i][0],nParams);
+            f(j,i) = function(&p.vector,x0[j]);
+        }
+    }
+    return f;
+}
+
+ErrorBand DistributionFitter::errorBand(const std::vector<double> &x0, double cl)
+{
+    Eigen::MatrixXd f = evaluate(x0);
+    size_t nPoints  = x0.size();
+    bool resampled  = (resamplingType != "none");
+    int  nMeas      = (resampled) ? nSamples-1 : nSamples;
+    // jackknife samples are squeezed by sqrt(N-1) about the central value
+    double scale    = (resamplingType == "jackknife") ? Grid::sqrt(double(nMeas-1)) : 1.0;
+    double factor   = (resamplingType == "jackknife") ? nMeas-1 : 1;
+
+    ErrorBand band;
+    band.x = x0;
+    band.central.resize(nPoints);
+    band.std.resize(nPoints);
+    band.lower.resize(nPoints);
+    band.upper.resize(nPoints);
+
+    parallel_for (int j=0; j<(int)nPoints; j++)
+    {
+        double central = (resampled) ? f(j,nSamples-1) : f.row(j).mean();
+        std::vector<double> dev(nMeas);
+        double var = 0;
+        for (int i=0; i<nMeas; i++)
+        {
+            dev[i]  = f(j,i) - central;
+            var    += dev[i]*dev[i];
+        }
+        band.central[j] = central;
+        band.std[j]     = Grid::sqrt(var*factor/nMeas);
+
+        // percentile with linear interpolation between order statistics
+        auto percentile = [&](double q)
+        {
+            double pos  = q*(nMeas-1);
+            size_t lo   = static_cast<size_t>(pos);
+            std::nth_element(dev.begin(),dev.begin()+lo,dev.end());
+            double v    = dev[lo];
+            if(lo+1 < (size_t)nMeas)
+            {
+                double next = *std::min_element(dev.begin()+lo+1,dev.end());
+                v += (pos-lo)*(next-v);
+            }
+            return central + scale*v;
+        };
+        band.lower[j] = percentile(0.5*(1.0-cl));
+        band.upper[j] = percentile(0.5*(1.0+cl));
+    }
+    return band;
+}
+
 #endif
@@ -54,6 +54,10 @@ int main(int argc, char *argv[])
     std::string LambdaV_file   = parseParam<std::string>(reader,"LambdaV_file");
     std::string LambdaA_file   = parseParam<std::string>(reader,"LambdaA_file");
     std::string output_dir     = parseParam<std::string>(reader,"output_dir");
+    bool chiral_mixing          = static_cast<bool>(parseParam<int>(reader,"chiral_mixing",0));
+    bool check_mixing           = static_cast<bool>(parseParam<int>(reader,"check_mixing",0));
+    std::string tree_cache      = parseParam<std::string>(reader,"tree_cache",std::string(""));
+    fourquark_mixed_precision() = static_cast<bool>(parseParam<int>(reader,"mixed_precision",0));
     
     
     ////////////////////////////////////////////////////////////////////////////////////////
@@ -158,19 +162,39 @@ int main(int argc, char *argv[])
     //auto vertex = get_vector_resample(get_vector_distributions(fourQ),resampling,bootstraps);
     
 
+    //////////////////////////////////////////////////////////
+    // Check the vectorised contraction kernels and the sparse gammas
+    //////////////////////////////////////////////////////////
+    if(!fourquark_simd_check())
+    {
+        std::cout << "Error: vectorised four quark kernels do not match their reference, check the floating point flags" << std::endl;
+        return -1;
+    }
+    if(!sparse_gamma_check())
+    {
+        std::cout << "Error: sparse gamma table does not match Grid's gamma convention" << std::endl;
+        return -1;
+    }
+
     //////////////////////////////////////////////////////////
     // Perform the projections on tree to get F and invert 
     //////////////////////////////////////////////////////////
-    Eigen::MatrixXd tree(Nop,Nop);
-    for(int i=0;i<Nop;i++)
+    // gamma scheme is constant, qslash depends on the momentum geometry and is cached
+    Eigen::MatrixXd tree = tree_matrix(gamma_scheme_tree);
+    if(qslash_4q)
     {
-        for(int j=0;j<Nop;j++)
-        {
-            tree(i,j) = projectTree(vertex_basis[i],basis[j],colourMix[j]);
-            std::cout << tree(i,j) << "\t";
-        }
-        std::cout << std::endl;
+        TreeCache cache(tree_cache);
+        tree = cache.get(scheme,p1,p2,[&](){
+            Eigen::MatrixXd tr(Nop,Nop);
+            for(int i=0;i<Nop;i++)
+            for(int j=0;j<Nop;j++)
+            {
+                tr(i,j) = projectTree(vertex_basis[i],basis[j],colourMix[j]);
+            }
+            return tr;
+        });
     }
+    std::cout << tree << std::endl;
     Eigen::MatrixXd treeInv =   tree.inverse();
     std::cout << "tree inverted" << std::endl;
 
@@ -188,13 +212,8 @@ int main(int argc, char *argv[])
         SpinColourMatrix  rho;
         rho = rho + Complex(1,0);
         rho = rho*Gamma(i);
-        for(int si=0; si < Ns; ++si){
-        for(int sj=0; sj < Ns; ++sj){
-            for (int ci=0; ci < Nc; ++ci){
-            for (int cj=0; cj < Nc; ++cj){
-              vertex_rho[i]()(si,sj)(ci,cj)=rho()(si,sj)(ci,cj)*rho();
-            }}
-        }}
+        // vertex_rho[i](si,sj)(ci,cj)(sk,sl)(ck,cl) = rho(si,sj)(ci,cj)*rho(sk,sl)(ck,cl)
+        Contraction<SpinColourSpinColourLayout<'i','j','a','b','k','l','c','d'>,SpinColourLayout<'i','j','a','b'>,SpinColourLayout<'k','l','c','d'>>::assign(&vertex_rho[i]()(0,0)(0,0)(0,0)(0,0),{&rho()(0,0)(0,0),&rho()(0,0)(0,0)});
     }
 
     SpinColourMatrix  rho;
@@ -208,7 +227,10 @@ int main(int argc, char *argv[])
     //////////////////////////////////////////////////////////
     //Eigen::MatrixXd                 tmp(Nop,Nop);
     //Distribution<Eigen::MatrixXd>   lambda(std::vector<Eigen::MatrixXd>(configs.size(),tmp));
-    Distribution<Eigen::MatrixXd>   lambda  = projectFourQuark(Sin,Sout,vertex,vertex_basis,basis,colourMix);
+    // all 25 entries by default, only the chirally allowed ones with chiral_mixing ( all of them if checking the zeros )
+    MixingPattern                   pattern = (chiral_mixing) ? chiral_mixing_pattern() : MixingPattern();
+    pattern.check                           = check_mixing;
+    Distribution<Eigen::MatrixXd>   lambda  = projectFourQuark(Sin,Sout,vertex,vertex_basis,basis,colourMix,pattern);
     std::cout << "vertex projected" << std::endl;
     std::cout << lambda.get_value(0) << std::endl;
     
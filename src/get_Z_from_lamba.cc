@@ -7,6 +7,60 @@
 #include "AnalysisNPR.h"
 #include <random>
 
+////////////////////////////////////////////
+// Z factors of one Lambda directory and scheme, sample by sample in one pass:
+//      ZX = ZA LambdaA / LambdaX,  Zm = 1/ZS
+////////////////////////////////////////////
+struct ZFactors
+{
+    std::vector<double> ZS, ZP, ZT, ZV, Zm;
+};
+
+ZFactors z_factors(const std::vector<double> &LambdaA, const std::vector<double> &LambdaS, const std::vector<double> &LambdaP,
+                   const std::vector<double> &LambdaT, const std::vector<double> &LambdaV, const std::vector<double> &ZA)
+{
+    size_t n = ZA.size();
+    if(LambdaA.size() != n || LambdaS.size() != n || LambdaP.size() != n || LambdaT.size() != n || LambdaV.size() != n)
+    {
+        std::cout << "Error : Lambdas and ZA must have the same number of samples" << std::endl;
+        exit(1);
+    }
+    ZFactors Z;
+    Z.ZS.resize(n); Z.ZP.resize(n); Z.ZT.resize(n); Z.ZV.resize(n); Z.Zm.resize(n);
+    for(size_t i=0;i<n;i++)
+    {
+        double r    = ZA[i]*LambdaA[i];
+        Z.ZS[i]     = r/LambdaS[i];
+        Z.ZP[i]     = r/LambdaP[i];
+        Z.ZT[i]     = r/LambdaT[i];
+        Z.ZV[i]     = r/LambdaV[i];
+        Z.Zm[i]     = LambdaS[i]/r;
+    }
+    return Z;
+}
+
+// nBoot gaussian samples of ZA from a seeded generator, the central value last
+std::vector<double> za_samples(double za, double za_e, int nBoot, unsigned seed)
+{
+    std::default_random_engine generator(seed);
+    std::normal_distribution<double> distribution(za,za_e);
+    std::vector<double> za_vec;
+    for(int i =0 ; i<nBoot; i++)
+    {
+        za_vec.push_back(distribution(generator));
+    }
+    za_vec.push_back(za);
+    return za_vec;
+}
+
+std::vector<double> read_lambda(const std::string &LambdaDir, const std::string &name)
+{
+    std::vector<double> values;
+    Hdf5Reader reader(LambdaDir+"/"+name+".h5");
+    read(reader,name,values);
+    return values;
+}
+
 int main(int argc, char *argv[])
 {
     
@@ -36,11 +90,64 @@ int main(int argc, char *argv[])
     std::cout << "reader set up" << std::endl;
     //read the numerator and denominator infor
    
-    std::string LambdaDir   =   parseParam<std::string>(reader,"LambdaDir");
     double      za          =   parseParam<double>(reader,"ZA");
     double      za_e        =   parseParam<double>(reader,"ZAerror");
-    std::string scheme      =   parseParam<std::string>(reader,"scheme");
     std::string outputDir   =   parseParam<std::string>(reader,"outputDir");
+    unsigned    seed        =   parseParam<unsigned>(reader,"seed",std::default_random_engine::default_seed);
+
+    // batch mode: every Lambda directory in both schemes, all results in one file
+    std::vector<std::string> LambdaDirs = parseParam<std::vector<std::string>>(reader,"LambdaDirs",std::vector<std::string>());
+    if(!LambdaDirs.empty())
+    {
+        std::vector<std::string> schemes = parseParam<std::vector<std::string>>(reader,"schemes",std::vector<std::string>({"g","q"}));
+        for(auto &sch : schemes)
+        {
+            if(sch != "g" && sch != "q")
+            {
+                std::cout << "Error : scheme must be either g or q" << std::endl;
+                return -1;
+            }
+        }
+
+        // S, P and T are the same in both schemes, read once per directory
+        std::vector<std::vector<double>> vecS(LambdaDirs.size()), vecP(LambdaDirs.size()), vecT(LambdaDirs.size());
+        for(int d=0;d<LambdaDirs.size();d++)
+        {
+            vecS[d] = read_lambda(LambdaDirs[d],"LambdaSg");
+            vecP[d] = read_lambda(LambdaDirs[d],"LambdaPg");
+            vecT[d] = read_lambda(LambdaDirs[d],"LambdaTg");
+        }
+
+        // one set of ZA samples for every point
+        int nBoot = Distribution<double>(vecS[0],"bootstrap").get_Nmeas();
+        std::vector<double> za_vec = za_samples(za,za_e,nBoot,seed);
+
+        std::vector<std::vector<std::string>>           labels;
+        std::vector<std::vector<std::vector<double>>>   results;
+        labels.push_back({"ZA"});
+        results.push_back({za_vec});
+        for(int d=0;d<LambdaDirs.size();d++)
+        {
+            // results labelled by the last component of the directory
+            std::string dir = LambdaDirs[d].substr(0,LambdaDirs[d].find_last_not_of("/")+1);
+            std::string tag = dir.substr(dir.find_last_of("/")+1);
+            for(auto &sch : schemes)
+            {
+                ZFactors Z = z_factors(read_lambda(LambdaDirs[d],"LambdaA"+sch),vecS[d],vecP[d],vecT[d],read_lambda(LambdaDirs[d],"LambdaV"+sch),za_vec);
+                labels.push_back({tag+"_ZS"+sch,tag+"_ZP"+sch,tag+"_ZT"+sch,tag+"_ZV"+sch,tag+"_Zm"+sch});
+                results.push_back({Z.ZS,Z.ZP,Z.ZT,Z.ZV,Z.Zm});
+
+                Distribution<double> ZS(Z.ZS,"bootstrap"), ZV(Z.ZV,"bootstrap");
+                std::cout << tag << " " << sch << " : ZS = " << ZS.get_central() << " ± " << ZS.get_std()
+                          << ", ZV = " << ZV.get_central() << " ± " << ZV.get_std() << std::endl;
+            }
+        }
+        save_result<std::vector<double>>(outputDir+"/Z.h5",labels,results);
+        return 0;
+    }
+
+    std::string LambdaDir   =   parseParam<std::string>(reader,"LambdaDir");
+    std::string scheme      =   parseParam<std::string>(reader,"scheme");
 
     std::vector<std::string> vertices, out_vertices;
     if(scheme == "g")
@@ -62,48 +169,29 @@ int main(int argc, char *argv[])
     ////////////////////////////////////////////
     // Read in all the data
     ////////////////////////////////////////////
-    Hdf5Reader readA(LambdaDir+"/LambdaA"+scheme+".h5"), readV(LambdaDir+"/LambdaV"+scheme+".h5");
-    Hdf5Reader  readT(LambdaDir+"/LambdaTg.h5"), readP(LambdaDir+"/LambdaPg.h5"), readS(LambdaDir+"/LambdaSg.h5");
-    std::vector<double> vecA, vecV, vecT, vecS, vecP;
-    read(readA,"LambdaA"+scheme,vecA);
-    read(readV,"LambdaV"+scheme,vecV);
-    read(readS,"LambdaSg",vecS);
-    read(readP,"LambdaPg",vecP);
-    read(readT,"LambdaTg",vecT);
-
-    ////////////////////////////////////////////
-    // Create distributions
-    ////////////////////////////////////////////
-    Distribution<double> LambdaS(vecS,"bootstrap");
-    Distribution<double> LambdaP(vecP,"bootstrap");
-    Distribution<double> LambdaT(vecT,"bootstrap");
-    Distribution<double> LambdaV(vecV,"bootstrap");
-    Distribution<double> LambdaA(vecA,"bootstrap");
-   
-    int nBoot = LambdaS.get_Nmeas();
+    std::vector<double> vecA = read_lambda(LambdaDir,"LambdaA"+scheme);
+    std::vector<double> vecV = read_lambda(LambdaDir,"LambdaV"+scheme);
+    std::vector<double> vecS = read_lambda(LambdaDir,"LambdaSg");
+    std::vector<double> vecP = read_lambda(LambdaDir,"LambdaPg");
+    std::vector<double> vecT = read_lambda(LambdaDir,"LambdaTg");
 
     ////////////////////////////////////////////
     // generate bootstraps for ZA
     ////////////////////////////////////////////
-    std::default_random_engine generator;
-    std::normal_distribution<double> distribution(za,za_e);
-    std::vector<double> za_vec;
-    for(int i =0 ; i<nBoot; i++)
-    {
-        za_vec.push_back(distribution(generator));
-    }
-    za_vec.push_back(za); 
+    int nBoot = Distribution<double>(vecS,"bootstrap").get_Nmeas();
+    std::vector<double> za_vec = za_samples(za,za_e,nBoot,seed);
     Distribution<double> ZA(za_vec,"bootstrap");
 
 
     ////////////////////////////////////////////
     // Calculate Z from Lambda and ZA
     ////////////////////////////////////////////
-    Distribution<double> ZS     =   LambdaA*ZA*(1.0/LambdaS);
-    Distribution<double> ZP     =   LambdaA*ZA*(1.0/LambdaP);
-    Distribution<double> ZT     =   LambdaA*ZA*(1.0/LambdaT);
-    Distribution<double> ZV     =   LambdaA*ZA*(1.0/LambdaV);
-    Distribution<double> Zm     =   1.0/ZS;
+    ZFactors Z = z_factors(vecA,vecS,vecP,vecT,vecV,za_vec);
+    Distribution<double> ZS(Z.ZS,"bootstrap");
+    Distribution<double> ZP(Z.ZP,"bootstrap");
+    Distribution<double> ZT(Z.ZT,"bootstrap");
+    Distribution<double> ZV(Z.ZV,"bootstrap");
+    Distribution<double> Zm(Z.Zm,"bootstrap");
 
     ////////////////////////////////////////////
     // Print and write results
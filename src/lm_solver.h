@@ -0,0 +1,135 @@
+#ifndef LM_SOLVER_H
+#define LM_SOLVER_H
+
+#include <cmath>
+#include <cstddef>
+#include <gsl/gsl_errno.h>
+#include <Grid/Eigen/Dense>
+
+////////////////////////////////////////////////////////////////////////
+// Levenberg-Marquardt for small least squares fits
+//
+//      min_p sum_i ( Model::value(p,x_i) - y_i )^2
+//
+// Templated on the model, so the parameter count is known at compile time and every
+// vector and matrix in the iteration is a fixed size Eigen type on the stack. The model
+// is a type with
+//
+//      static constexpr int nParams;
+//      template<class P> static double value(const P &p, double x);
+//      template<class P> static void   gradient(const P &p, double x, P &g);   // d value / d p
+//
+// called directly, so it inlines. The Jacobian is never stored: the normal equations
+// J^T J and J^T r are accumulated point by point, so the data length ND only fixes the
+// loop bound when it is known at compile time. Damping is scaled by diag(J^T J), as in
+// gsl's lmsder, and the stopping tests use the same xtol / gtol conventions. Returns
+// GSL_SUCCESS, GSL_EMAXITER, or GSL_ENOPROG if no step reduces chi^2.
+////////////////////////////////////////////////////////////////////////
+template<class Model, int ND=Eigen::Dynamic>
+class LMSolver
+{
+    public:
+        static constexpr int NP = Model::nParams;
+        typedef Eigen::Matrix<double,NP,1>  Params;
+        typedef Eigen::Matrix<double,NP,NP> Normal;
+
+        size_t  maxIter;
+        double  xtol, gtol;
+
+        // results of the last solve
+        double  chi;
+        size_t  iterations;
+
+        LMSolver(size_t maxIter=20, double xtol=1e-8, double gtol=1e-8) : maxIter(maxIter), xtol(xtol), gtol(gtol), chi(0), iterations(0) {}
+
+        int solve(const double *x, const double *y, size_t n, Params &p);
+
+    private:
+        static size_t   points(size_t n){ return (ND == Eigen::Dynamic) ? n : size_t(ND); }
+        static double   chisq(const double *x, const double *y, size_t n, const Params &p);
+        static double   normal(const double *x, const double *y, size_t n, const Params &p, Normal &JtJ, Params &Jtr);
+};
+
+template<class Model, int ND>
+double LMSolver<Model,ND>::chisq(const double *x, const double *y, size_t n, const Params &p)
+{
+    double c = 0;
+    for(size_t i=0;i<points(n);i++)
+    {
+        double r = Model::value(p,x[i]) - y[i];
+        c += r*r;
+    }
+    return c;
+}
+
+template<class Model, int ND>
+double LMSolver<Model,ND>::normal(const double *x, const double *y, size_t n, const Params &p, Normal &JtJ, Params &Jtr)
+{
+    JtJ.setZero();
+    Jtr.setZero();
+    Params g;
+    double c = 0;
+    for(size_t i=0;i<points(n);i++)
+    {
+        double r = Model::value(p,x[i]) - y[i];
+        Model::gradient(p,x[i],g);
+        JtJ.noalias() += g*g.transpose();
+        Jtr           += r*g;
+        c             += r*r;
+    }
+    return c;
+}
+
+template<class Model, int ND>
+int LMSolver<Model,ND>::solve(const double *x, const double *y, size_t n, Params &p)
+{
+    Normal JtJ, damped;
+    Params Jtr, step, trial;
+    double lambda   = 1e-3;
+    double c        = normal(x,y,n,p,JtJ,Jtr);
+    int    status   = GSL_EMAXITER;
+
+    for(iterations=0; iterations<maxIter; )
+    {
+        // gradient test, scaled as gsl: max_k |g_k| max(|p_k|,1) <= gtol max(chi^2,1)
+        if((Jtr.cwiseAbs().cwiseProduct(p.cwiseAbs().cwiseMax(1.0))).maxCoeff() <= gtol*std::max(c,1.0))
+        {
+            status = GSL_SUCCESS;
+            break;
+        }
+
+        // raise the damping until the step lowers chi^2
+        double c_trial;
+        do
+        {
+            damped = JtJ;
+            damped.diagonal() += lambda*JtJ.diagonal().cwiseMax(1e-300);
+            step    = -damped.ldlt().solve(Jtr);
+            trial   = p + step;
+            c_trial = chisq(x,y,n,trial);
+            if(c_trial >= c){ lambda *= 10; }
+        }
+        while(c_trial >= c && lambda < 1e16 && step.cwiseAbs().maxCoeff() > 0);
+
+        iterations++;
+        if(c_trial >= c)
+        {
+            // no step improves the fit: converged if the step is already below xtol
+            status = ((step.cwiseAbs().array() <= xtol*(p.cwiseAbs().array()+xtol)).all()) ? GSL_SUCCESS : GSL_ENOPROG;
+            break;
+        }
+
+        p       = trial;
+        lambda  = std::max(lambda/10,1e-12);
+        c       = normal(x,y,n,p,JtJ,Jtr);
+        if((step.cwiseAbs().array() <= xtol*(p.cwiseAbs().array()+xtol)).all())
+        {
+            status = GSL_SUCCESS;
+            break;
+        }
+    }
+    chi = std::sqrt(c);
+    return status;
+}
+
+#endif
@@ -7,48 +7,45 @@
 //      Set up gamma structures and bases  
 ////////////////////////////////////////////////////////////////////////////////////////
 
+// gamma basis {VVpAA,VVmAA,SSmPP,SSpPP,TT} as Gamma::Algebra and signs
+constexpr DiracStructureSpec gamma_basis_spec[Nop] = {
+    {8, {Gamma::Algebra::GammaX,Gamma::Algebra::GammaY,Gamma::Algebra::GammaZ,Gamma::Algebra::GammaT,
+         Gamma::Algebra::GammaXGamma5,Gamma::Algebra::GammaYGamma5,Gamma::Algebra::GammaZGamma5,Gamma::Algebra::GammaTGamma5},
+        {1,1,1,1,1,1,1,1}},
+    {8, {Gamma::Algebra::GammaX,Gamma::Algebra::GammaY,Gamma::Algebra::GammaZ,Gamma::Algebra::GammaT,
+         Gamma::Algebra::GammaXGamma5,Gamma::Algebra::GammaYGamma5,Gamma::Algebra::GammaZGamma5,Gamma::Algebra::GammaTGamma5},
+        {1,1,1,1,-1,-1,-1,-1}},
+    {2, {Gamma::Algebra::Identity,Gamma::Algebra::Gamma5}, {1,-1}},
+    {2, {Gamma::Algebra::Identity,Gamma::Algebra::Gamma5}, {1,1}},
+    {6, {Gamma::Algebra::SigmaXY,Gamma::Algebra::SigmaXZ,Gamma::Algebra::SigmaXT,
+         Gamma::Algebra::SigmaYZ,Gamma::Algebra::SigmaYT,Gamma::Algebra::SigmaZT},
+        {1,1,1,1,1,1}}};
+
+// tree level F_ij of the gamma scheme, fixed at compile time
+constexpr bool                  gamma_scheme_colourMix[Nop] = {false,false,false,false,false};
+constexpr FourQuarkTree<Nop>    gamma_scheme_tree           = four_quark_tree(gamma_basis_spec,gamma_basis_spec,gamma_scheme_colourMix,Nc);
+
 std::vector<DiracStructure> gamma_basis()
 {
     /////////////// gamma basis ////////////////
-    //VVpAA
-
-    // dirac structures for full basis
-    DiracStructure  VVpAA;
-    DiracStructure  VVmAA;
-    DiracStructure  SSmPP;
-    DiracStructure  SSpPP;
-    DiracStructure  TT;
-    
-    SpinMatrix rho;
-    rho = rho+Complex(1.0,0);
-    for(int i=0;i<gmu.size();i++){  VVpAA.gammas.push_back(rho*Gamma(gmu[i])); VVpAA.indices.push_back(gmu[i]);   }
-    for(int i=0;i<gmug5.size();i++) {  VVpAA.gammas.push_back(rho*Gamma(gmug5[i])); VVpAA.indices.push_back(gmug5[i]);  }
-    VVpAA.signs     = {1,1,1,1,1,1,1,1};
-
-    //VVmAA
-    VVmAA.gammas    = VVpAA.gammas;
-    VVmAA.indices    = VVpAA.indices;
-    VVmAA.signs     = {1,1,1,1,-1,-1,-1,-1};
-
-    //SSpPP
-    SSpPP.signs     = {1,1};
-    SSpPP.gammas.push_back(rho*Gamma(I[0]));
-    SSpPP.gammas.push_back(rho*Gamma(g5[0]));
-    SSpPP.indices.push_back(I[0]);
-    SSpPP.indices.push_back(g5[0]);
-
-    //SSmPP
-    SSmPP.signs     = {1,-1};
-    SSmPP.gammas    = SSpPP.gammas;
-    SSmPP.indices   = SSpPP.indices;
-
-    //TT
-    TT.signs        =   {1,1,1,1,1,1};
-    for(int i=0;i<sigma_mu_nu.size();i++){  TT.gammas.push_back(rho*Gamma(sigma_mu_nu[i])); TT.indices.push_back(sigma_mu_nu[i]); }
-    std::vector<DiracStructure> basis = {VVpAA,VVmAA,SSmPP,SSpPP,TT};
+    std::vector<DiracStructure> basis(Nop);
+    for(int i=0;i<Nop;i++)
+    {
+        for(int nu=0;nu<gamma_basis_spec[i].n;nu++)
+        {
+            basis[i].push_back(Gamma::Algebra(gamma_basis_spec[i].gammas[nu]));
+            basis[i].signs.push_back(gamma_basis_spec[i].signs[nu]);
+        }
+    }
     return basis;
 }
 
+// chiral blocks of the gamma (and qslash) basis: VVpAA (27,1), {VVmAA,SSmPP} (8,8), {SSpPP,TT} (6,6)
+MixingPattern chiral_mixing_pattern()
+{
+    return block_mixing_pattern({{0},{1,2},{3,4}},Nop);
+}
+
 std::vector<DiracStructure> qslash_basis(std::vector<double> p1, std::vector<double> p2)
 {
     
@@ -90,9 +87,7 @@ std::vector<DiracStructure> qslash_basis(std::vector<double> p1, std::vector<dou
     SpinMatrix qslash;
     for(int i=0;i<4;i++)
     {
-        SpinMatrix Grho;
-        Grho = Grho+ Complex(1,0);
-        qslash = qslash + (Grho*Grid::QCD::Gamma(gmu[i]))*q[i];
+        qslash = qslash + SparseGamma(gmu[i]).dense()*q[i];
     }
     
     int count=0;
@@ -104,7 +99,7 @@ std::vector<DiracStructure> qslash_basis(std::vector<double> p1, std::vector<dou
         SpinMatrix Grho;
         Grho = Grho+ Complex(1,0);
         psigp = psigp + TT.gammas[count]*0.5*(p1[j]*p2[i]/Grid::sqrt(p1sq*p2sq-pow(p1dotp2,2)));
-        psigp = psigp - TT.gammas[count]*Grid::QCD::Gamma(g5[0])*0.5*(p1[j]*p2[i]/Grid::sqrt(p1sq*p2sq-pow(p1dotp2,2)));
+        psigp = psigp - (TT.sparse[count]*SparseGamma(g5[0])).dense()*0.5*(p1[j]*p2[i]/Grid::sqrt(p1sq*p2sq-pow(p1dotp2,2)));
         count++;
         }
     }
@@ -118,7 +113,7 @@ std::vector<DiracStructure> qslash_basis(std::vector<double> p1, std::vector<dou
         }
         else
         {
-            VVpAAq.gammas.push_back(qslash*Grid::QCD::Gamma(g5[0])*(1.0/Grid::sqrt(qsq)));
+            VVpAAq.gammas.push_back(qslash*SparseGamma(g5[0])*(1.0/Grid::sqrt(qsq)));
         }
     }
 
@@ -127,8 +122,9 @@ std::vector<DiracStructure> qslash_basis(std::vector<double> p1, std::vector<dou
     VVmAAq.signs = VVmAA.signs;
 
 
-    //TT
+    //TT - qslash weighted, dense only
     TTq=TT;
+    TTq.sparse.clear();
     // j < i
     count = 0;
     for(int i=0;i<Nd;i++)
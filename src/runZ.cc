@@ -0,0 +1,86 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Grid/Grid.h"
+#include "AnalysisNPR.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////
+//              Converts a Z factor to MSbar and runs it to another scale
+//
+//      Z_MSbar(mu_to) = U(mu_to,mu_from) C(mu_from) Z(mu_from)
+//      anomalous_dimension : mass ( Zm ), scalar ( ZS, ZP ) or none ( ZV, ZA )
+//      conversion          : c_k of C = 1 + sum_k c_k (alpha_s/pi)^(k+1), empty for none
+//      The running is tabulated once, every sample then costs a multiplication.
+///////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char *argv[])
+{
+    std::string parameterFileName;
+
+    if (argc <= 1)
+    {
+        std::cout << "Usage - " << argv[0] << " <input xml filename>" << std::endl;
+        // write to template in case failure
+        std::vector<std::string> par_list = {"input_file","label","resamplingType","mu_from","mu_to","anomalous_dimension","output_file"};
+        Grid::XmlWriter writer("template.xml");
+        for ( auto par_name : par_list ){ write(writer,par_name,""); }
+
+        // exit with err
+        return -1;
+    }
+    else
+    {
+        parameterFileName=argv[1];
+    }
+
+    // set up xml reader
+    Grid::XmlReader reader(parameterFileName);
+
+    std::string         input_file  = parseParam<std::string>(reader,"input_file");
+    std::string         label       = parseParam<std::string>(reader,"label");
+    std::string         resampling  = parseParam<std::string>(reader,"resamplingType");
+    double              mu_from     = parseParam<double>(reader,"mu_from");
+    double              mu_to       = parseParam<double>(reader,"mu_to");
+    std::string         gamma_name  = parseParam<std::string>(reader,"anomalous_dimension");
+    std::string         output_file = parseParam<std::string>(reader,"output_file");
+    int                 loops       = parseParam<int>(reader,"loops",4);
+    std::vector<double> conversion  = parseParam<std::vector<double>>(reader,"conversion",std::vector<double>());
+
+    std::function<std::vector<Eigen::MatrixXd>(int)> gamma;
+    if      (gamma_name == "mass")  { gamma = running::gamma_mass; }
+    else if (gamma_name == "scalar"){ gamma = running::gamma_scalar; }
+    else if (gamma_name == "none")  { gamma = [](int nf){ return std::vector<Eigen::MatrixXd>(1,Eigen::MatrixXd::Zero(1,1)); }; }
+    else
+    {
+        std::cout << "Error : anomalous_dimension must be mass, scalar or none" << std::endl;
+        return -1;
+    }
+
+    ////////////////////// read Z //////////////////////
+    std::vector<double> values;
+    Hdf5Reader h5reader(input_file);
+    read(h5reader,label,values);
+    Distribution<double> Z(values,resampling);
+
+    ////////////////////// tabulate the running over the range needed //////////////////////
+    RunningCoupling     coupling(loops,std::min(std::min(mu_from,mu_to),1.0),std::max(std::max(mu_from,mu_to),double(MZ)));
+    OperatorRunning     run(coupling,gamma,mu_to);
+
+    double C = 1.0;
+    if(!conversion.empty())
+    {
+        std::vector<Eigen::MatrixXd> c;
+        for(auto ck : conversion){ c.push_back(Eigen::MatrixXd::Constant(1,1,ck)); }
+        C = scheme_conversion(coupling,c,mu_from)(0,0);
+    }
+    Distribution<double> Z_out = run.run(Z*C,mu_from,mu_to);
+
+    std::cout << "alpha_s(" << mu_from << " GeV) = " << coupling.alpha_s(mu_from) << ", alpha_s(" << mu_to << " GeV) = " << coupling.alpha_s(mu_to) << std::endl;
+    std::cout << label << "(" << mu_from << " GeV) = " << Z.get_central() << " ± " << Z.get_std() << std::endl;
+    std::cout << label << " MSbar(" << mu_to << " GeV) = " << Z_out.get_central() << " ± " << Z_out.get_std() << std::endl;
+    save_result<std::vector<double>>(output_file,label,Z_out.get_values());
+
+    return 0;
+}
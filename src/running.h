@@ -0,0 +1,379 @@
+#ifndef RUNNING_H
+#define RUNNING_H
+
+#include <iostream>
+#include <vector>
+#include <functional>
+#include <cmath>
+#include <Grid/Eigen/Dense>
+
+////////////////////////////////////////////////////////////////////////
+// Perturbative running in the MSbar scheme, a = alpha_s/pi
+//
+//      da/dln(mu^2)    = - sum_k beta_k a^(k+2)
+//      dZ/dln(mu^2)    = - gamma(a) Z,     gamma(a) = sum_k gamma_k a^(k+1)
+//
+// up to four loops. The coupling starts from alphaMZ at MZ with nf=5 and crosses the Mb and
+// Mc thresholds ( global.h ) with the decoupling at mu = m(m). Both the coupling and the
+// evolution matrices are integrated once on a fine grid in ln(mu^2) and interpolated with
+// cubic Hermite polynomials ( the derivatives are the RG equations themselves ), so
+// converting any number of samples costs an interpolation and a matrix product.
+////////////////////////////////////////////////////////////////////////
+
+namespace running
+{
+    const double zeta3 = 1.2020569031595942;
+    const double zeta4 = 1.0823232337111382;
+    const double zeta5 = 1.0369277551433699;
+
+    std::vector<double> beta_coefficients(int nf)
+    {
+        double n = nf;
+        return {(11.0 - 2.0/3.0*n)/4.0,
+                (102.0 - 38.0/3.0*n)/16.0,
+                (2857.0/2.0 - 5033.0/18.0*n + 325.0/54.0*n*n)/64.0,
+                (149753.0/6.0 + 3564.0*zeta3 - (1078361.0/162.0 + 6508.0/27.0*zeta3)*n
+                    + (50065.0/162.0 + 6472.0/81.0*zeta3)*n*n + 1093.0/729.0*n*n*n)/256.0};
+    }
+
+    // quark mass, dm/dln(mu^2) = - gamma_m(a) m
+    std::vector<double> mass_anomalous_dimension(int nf)
+    {
+        double n = nf;
+        return {1.0,
+                (202.0/3.0 - 20.0/9.0*n)/16.0,
+                (1249.0 + (-2216.0/27.0 - 160.0/3.0*zeta3)*n - 140.0/81.0*n*n)/64.0,
+                (4603055.0/162.0 + 135680.0/27.0*zeta3 - 8800.0*zeta5
+                    + (-91723.0/27.0 - 34192.0/9.0*zeta3 + 880.0*zeta4 + 18400.0/9.0*zeta5)*n
+                    + (5242.0/243.0 + 800.0/9.0*zeta3 - 160.0/3.0*zeta4)*n*n
+                    + (-332.0/243.0 + 64.0/27.0*zeta3)*n*n*n)/256.0};
+    }
+
+    // as 1x1 matrices for OperatorRunning; Zm runs as the mass, ZS = 1/Zm with the opposite sign
+    std::vector<Eigen::MatrixXd> gamma_mass(int nf)
+    {
+        std::vector<Eigen::MatrixXd> gamma;
+        for(auto g : mass_anomalous_dimension(nf)){ gamma.push_back(Eigen::MatrixXd::Constant(1,1,g)); }
+        return gamma;
+    }
+
+    std::vector<Eigen::MatrixXd> gamma_scalar(int nf)
+    {
+        std::vector<Eigen::MatrixXd> gamma = gamma_mass(nf);
+        for(auto &g : gamma){ g = -g; }
+        return gamma;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////
+// a(mu) tabulated between mu_min and mu_max
+////////////////////////////////////////////////////////////////////////
+class RunningCoupling
+{
+    public:
+        // nf fixed between thresholds, nodes uniform in t = ln(mu^2)
+        struct Segment
+        {
+            int                 nf;
+            double              t0, dt;
+            std::vector<double> a;
+        };
+
+    private:
+        int                     loops;
+        std::vector<Segment>    segments;      // increasing in mu
+
+        double  beta(double a, int nf) const;
+        double  rk4(double a, double dt, int nf) const;
+        // a^(nf-1) from a^(nf) at mu = m(m)
+        double  decouple(double a, int nf) const;
+
+    public:
+        RunningCoupling(int loops=4, double mu_min=1.0, double mu_max=MZ, double steps_per_unit=200);
+
+        int                             get_loops() const { return loops; }
+        const std::vector<Segment> &    get_segments() const { return segments; }
+        const Segment &                 segment(double t) const;
+
+        double  a(double mu) const;
+        double  alpha_s(double mu) const { return M_PI*a(mu); }
+        int     nf(double mu) const { return segment(std::log(mu*mu)).nf; }
+        // a at node i of a segment and its t derivative
+        double  da_dt(double a, int nf) const { return -beta(a,nf); }
+};
+
+double RunningCoupling::beta(double a, int nf) const
+{
+    std::vector<double> b = running::beta_coefficients(nf);
+    double sum = 0, an = a*a;
+    for(int k=0;k<loops;k++)
+    {
+        sum += b[k]*an;
+        an  *= a;
+    }
+    return sum;
+}
+
+double RunningCoupling::rk4(double a, double dt, int nf) const
+{
+    double k1 = -beta(a,nf);
+    double k2 = -beta(a+0.5*dt*k1,nf);
+    double k3 = -beta(a+0.5*dt*k2,nf);
+    double k4 = -beta(a+dt*k3,nf);
+    return a + dt*(k1+2*k2+2*k3+k4)/6.0;
+}
+
+double RunningCoupling::decouple(double a, int nf) const
+{
+    double nl = nf-1;
+    double c2 = (loops >= 3) ? 11.0/72.0 : 0;
+    double c3 = (loops >= 4) ? 564731.0/124416.0 - 82043.0/27648.0*running::zeta3 - 2633.0/31104.0*nl : 0;
+    return a*(1.0 + c2*a*a + c3*a*a*a);
+}
+
+RunningCoupling::RunningCoupling(int loops, double mu_min, double mu_max, double steps_per_unit) : loops(loops)
+{
+    if(loops < 1 || loops > 4)
+    {
+        std::cout << "Error - running coupling is implemented for 1 to 4 loops" << std::endl;
+        exit(1);
+    }
+
+    // segment edges in t, from mu_max down to mu_min; the thresholds inside the range split it
+    double t_max = std::log(mu_max*mu_max), t_min = std::log(mu_min*mu_min);
+    double t_mz  = std::log(MZ*MZ);
+    std::vector<double> edges = {std::max(t_max,t_mz)};
+    std::vector<int>    flavours;
+    int nf = 5;
+    for(double m : {double(Mb),double(Mc)})
+    {
+        double t = std::log(m*m);
+        if(t <= t_min){ break; }
+        edges.push_back(t);
+        flavours.push_back(nf--);
+    }
+    edges.push_back(std::min(t_min,t_mz));
+    flavours.push_back(nf);
+
+    // integrate up from MZ to the top edge, then down through the thresholds
+    double a_mz = alphaMZ/M_PI;
+    std::vector<Segment> down;
+    double a_start = a_mz;
+    for(int s=0;s<flavours.size();s++)
+    {
+        Segment seg;
+        seg.nf = flavours[s];
+        int    nSteps = std::max(1,int(std::ceil((edges[s]-edges[s+1])*steps_per_unit)));
+        seg.dt  = (edges[s]-edges[s+1])/nSteps;
+        seg.t0  = edges[s+1];
+
+        // the first segment holds MZ: start there and go both ways
+        std::vector<double> a(nSteps+1);
+        if(s == 0)
+        {
+            int i_mz = int(std::round((t_mz-seg.t0)/seg.dt));
+            double a_node = a_mz;
+            // MZ is not generally a node: step to the nearest one first
+            a_node = rk4(a_node,seg.t0+i_mz*seg.dt-t_mz,seg.nf);
+            a[i_mz] = a_node;
+            for(int i=i_mz;i<nSteps;i++){ a[i+1] = rk4(a[i],seg.dt,seg.nf); }
+            for(int i=i_mz;i>0;i--)     { a[i-1] = rk4(a[i],-seg.dt,seg.nf); }
+        }
+        else
+        {
+            a[nSteps] = a_start;
+            for(int i=nSteps;i>0;i--){ a[i-1] = rk4(a[i],-seg.dt,seg.nf); }
+        }
+        seg.a = a;
+        down.push_back(seg);
+
+        // continue below the threshold with one flavour fewer
+        a_start = decouple(a[0],seg.nf);
+    }
+    segments.assign(down.rbegin(),down.rend());
+}
+
+const RunningCoupling::Segment & RunningCoupling::segment(double t) const
+{
+    for(auto &seg : segments)
+    {
+        if(t <= seg.t0 + seg.dt*(seg.a.size()-1)){ return seg; }
+    }
+    return segments.back();
+}
+
+double RunningCoupling::a(double mu) const
+{
+    double t = std::log(mu*mu);
+    const Segment &seg = segment(t);
+    int last = seg.a.size()-1;
+    if(t < seg.t0 - 1e-12 || t > seg.t0 + seg.dt*last + 1e-12)
+    {
+        std::cout << "Error - mu = " << mu << " GeV outside the tabulated running" << std::endl;
+        exit(1);
+    }
+
+    // cubic Hermite on the interval holding t
+    int    i  = std::min(last-1,std::max(0,int((t-seg.t0)/seg.dt)));
+    double h  = (t-seg.t0)/seg.dt - i;
+    double y0 = seg.a[i], y1 = seg.a[i+1];
+    double d0 = seg.dt*da_dt(y0,seg.nf), d1 = seg.dt*da_dt(y1,seg.nf);
+    double h2 = h*h, h3 = h2*h;
+    return (2*h3-3*h2+1)*y0 + (h3-2*h2+h)*d0 + (-2*h3+3*h2)*y1 + (h3-h2)*d1;
+}
+
+
+////////////////////////////////////////////////////////////////////////
+// U(mu) = U(mu,mu0) for dU/dln(mu^2) = -gamma(a(mu)) U, U(mu0) = 1, on the coupling's grid
+//
+// gamma(nf) gives the coefficient matrices gamma_k, one per loop ( used up to the
+// coupling's loop order ). U is continuous across thresholds.
+////////////////////////////////////////////////////////////////////////
+class OperatorRunning
+{
+    private:
+        const RunningCoupling                                   &coupling;
+        std::function<std::vector<Eigen::MatrixXd>(int)>        gamma;
+        int                                                     size;
+        std::vector<std::vector<Eigen::MatrixXd>>               U;      // [segment][node]
+
+        Eigen::MatrixXd derivative(const Eigen::MatrixXd &u, double a, int nf) const;
+        Eigen::MatrixXd gamma_at(double a, int nf) const;
+
+    public:
+        OperatorRunning(const RunningCoupling &coupling, std::function<std::vector<Eigen::MatrixXd>(int)> gamma, double mu0);
+
+        // U(mu,mu0)
+        Eigen::MatrixXd evolution(double mu) const;
+        // Z(mu_to) = U(mu_to,mu_from) Z(mu_from)
+        Eigen::MatrixXd evolution(double mu_to, double mu_from) const { return evolution(mu_to)*evolution(mu_from).inverse(); }
+
+        Distribution<Eigen::MatrixXd>   run(Distribution<Eigen::MatrixXd> Z, double mu_from, double mu_to) const;
+        Distribution<double>            run(Distribution<double> Z, double mu_from, double mu_to) const;
+};
+
+Eigen::MatrixXd OperatorRunning::gamma_at(double a, int nf) const
+{
+    std::vector<Eigen::MatrixXd> g = gamma(nf);
+    Eigen::MatrixXd sum = Eigen::MatrixXd::Zero(size,size);
+    double an = a;
+    for(int k=0;k<std::min<int>(g.size(),coupling.get_loops());k++)
+    {
+        sum += g[k]*an;
+        an  *= a;
+    }
+    return sum;
+}
+
+Eigen::MatrixXd OperatorRunning::derivative(const Eigen::MatrixXd &u, double a, int nf) const
+{
+    return -gamma_at(a,nf)*u;
+}
+
+OperatorRunning::OperatorRunning(const RunningCoupling &coupling, std::function<std::vector<Eigen::MatrixXd>(int)> gamma, double mu0)
+    : coupling(coupling), gamma(gamma)
+{
+    const std::vector<RunningCoupling::Segment> &segs = coupling.get_segments();
+    size = gamma(segs[0].nf)[0].rows();
+    U.resize(segs.size());
+    for(int s=0;s<segs.size();s++){ U[s].resize(segs[s].a.size()); }
+
+    // a(t) at the midpoint of an interval, for RK4 in t
+    auto a_mid = [&](const RunningCoupling::Segment &seg, int i)
+    {
+        return coupling.a(std::exp(0.5*(seg.t0+(i+0.5)*seg.dt)));
+    };
+    auto step = [&](const RunningCoupling::Segment &seg, const Eigen::MatrixXd &u, int from, int to)
+    {
+        double dt = (to-from)*seg.dt;
+        double a0 = seg.a[from], a1 = seg.a[to], am = a_mid(seg,std::min(from,to));
+        Eigen::MatrixXd k1 = derivative(u,a0,seg.nf);
+        Eigen::MatrixXd k2 = derivative(u+0.5*dt*k1,am,seg.nf);
+        Eigen::MatrixXd k3 = derivative(u+0.5*dt*k2,am,seg.nf);
+        Eigen::MatrixXd k4 = derivative(u+dt*k3,a1,seg.nf);
+        return Eigen::MatrixXd(u + dt*(k1+2*k2+2*k3+k4)/6.0);
+    };
+
+    // start at the node nearest mu0, then fill its segment and the others outwards
+    double t0 = std::log(mu0*mu0);
+    int s0 = 0;
+    while(s0 < segs.size()-1 && t0 > segs[s0].t0+segs[s0].dt*(segs[s0].a.size()-1)){ s0++; }
+    const RunningCoupling::Segment &seg0 = segs[s0];
+    int i0 = std::min<int>(seg0.a.size()-1,std::max(0,int(std::round((t0-seg0.t0)/seg0.dt))));
+    // from mu0 to node i0 with a single RK4 step
+    {
+        double dt = seg0.t0+i0*seg0.dt-t0;
+        Eigen::MatrixXd u  = Eigen::MatrixXd::Identity(size,size);
+        double a0 = coupling.a(mu0), a1 = seg0.a[i0], am = coupling.a(std::exp(0.5*(t0+0.5*dt)));
+        Eigen::MatrixXd k1 = derivative(u,a0,seg0.nf);
+        Eigen::MatrixXd k2 = derivative(u+0.5*dt*k1,am,seg0.nf);
+        Eigen::MatrixXd k3 = derivative(u+0.5*dt*k2,am,seg0.nf);
+        Eigen::MatrixXd k4 = derivative(u+dt*k3,a1,seg0.nf);
+        U[s0][i0] = u + dt*(k1+2*k2+2*k3+k4)/6.0;
+    }
+    int n0 = seg0.a.size()-1;
+    for(int i=i0;i<n0;i++){ U[s0][i+1] = step(seg0,U[s0][i],i,i+1); }
+    for(int i=i0;i>0;i--) { U[s0][i-1] = step(seg0,U[s0][i],i,i-1); }
+    for(int s=s0+1;s<segs.size();s++)
+    {
+        U[s][0] = U[s-1].back();
+        for(int i=0;i<segs[s].a.size()-1;i++){ U[s][i+1] = step(segs[s],U[s][i],i,i+1); }
+    }
+    for(int s=s0-1;s>=0;s--)
+    {
+        int n = segs[s].a.size()-1;
+        U[s][n] = U[s+1][0];
+        for(int i=n;i>0;i--){ U[s][i-1] = step(segs[s],U[s][i],i,i-1); }
+    }
+}
+
+Eigen::MatrixXd OperatorRunning::evolution(double mu) const
+{
+    double t = std::log(mu*mu);
+    const std::vector<RunningCoupling::Segment> &segs = coupling.get_segments();
+    int s = 0;
+    while(s < segs.size()-1 && t > segs[s].t0+segs[s].dt*(segs[s].a.size()-1)){ s++; }
+    const RunningCoupling::Segment &seg = segs[s];
+    int last = seg.a.size()-1;
+
+    int    i  = std::min(last-1,std::max(0,int((t-seg.t0)/seg.dt)));
+    double h  = (t-seg.t0)/seg.dt - i;
+    double h2 = h*h, h3 = h2*h;
+    Eigen::MatrixXd d0 = seg.dt*derivative(U[s][i],seg.a[i],seg.nf);
+    Eigen::MatrixXd d1 = seg.dt*derivative(U[s][i+1],seg.a[i+1],seg.nf);
+    return (2*h3-3*h2+1)*U[s][i] + (h3-2*h2+h)*d0 + (-2*h3+3*h2)*U[s][i+1] + (h3-h2)*d1;
+}
+
+Distribution<Eigen::MatrixXd> OperatorRunning::run(Distribution<Eigen::MatrixXd> Z, double mu_from, double mu_to) const
+{
+    Eigen::MatrixXd u = evolution(mu_to,mu_from);
+    std::vector<Eigen::MatrixXd> values = Z.get_values();
+    for(auto &v : values){ v = u*v; }
+    return Distribution<Eigen::MatrixXd>(values,Z.get_resamplingType());
+}
+
+Distribution<double> OperatorRunning::run(Distribution<double> Z, double mu_from, double mu_to) const
+{
+    double u = evolution(mu_to,mu_from)(0,0);
+    std::vector<double> values = Z.get_values();
+    for(auto &v : values){ v *= u; }
+    return Distribution<double>(values,Z.get_resamplingType());
+}
+
+////////////////////////////////////////////////////////////////////////
+// scheme conversion C(mu) = 1 + sum_k c_k a(mu)^(k+1), e.g. RI/SMOM -> MSbar from the
+// perturbative coefficients of the scheme, applied as Z_MSbar = C Z
+////////////////////////////////////////////////////////////////////////
+Eigen::MatrixXd scheme_conversion(const RunningCoupling &coupling, const std::vector<Eigen::MatrixXd> &c, double mu)
+{
+    double a  = coupling.a(mu), an = a;
+    Eigen::MatrixXd C = Eigen::MatrixXd::Identity(c[0].rows(),c[0].cols());
+    for(auto &ck : c)
+    {
+        C  += ck*an;
+        an *= a;
+    }
+    return C;
+}
+
+#endif